@@ -54,11 +54,18 @@ declare -A REQ_SOURCES=(
 	[libjpeg]="jpeg-9b"
 )
 
+# FFTW is built twice, double precision (libfftw3) then single precision (libfftw3f).
+# Set FFT_THREADS=1 to build FFTW with threads, needed by 'make FFT_THREADS=1'
+fftw_configure_flags="--disable-fortran"
+if [[ "${FFT_THREADS:-0}" == "1" ]]; then
+	fftw_configure_flags="${fftw_configure_flags} --enable-threads CFLAGS=-pthread"
+fi
+
 declare -A REQ_ACTIONS=(
 	[eigen]="cp -r Eigen ${THIS_INCLUDE_DIR};"
 	#[cfitsio]="configure --disable-curl --without-zlib-check --without-fortran;  make; install;"
 	[cfitsio]="configure --disable-curl --without-fortran;  make; install;"
-	[fftw]="configure --disable-fortran; make; install;"
+	[fftw]="configure ${fftw_configure_flags}; make; install; make clean; configure ${fftw_configure_flags} --enable-float; make; install;"
 	[netpbm]="configure; make; install;"
 	[zlib]="./configure; make; install;"
 	[libjpeg]="configure; make; install;"
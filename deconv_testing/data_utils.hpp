@@ -930,8 +930,9 @@ namespace data_utils{
 
 	// COPYING ARRAYS
 
-	template<class T>
-	void copy_to(const std::vector<T>& a, std::vector<T>& b, size_t from_idx=0, size_t to_idx=0){
+	// Element types can differ, e.g., to copy double data into a float array
+	template<class T1, class T2>
+	void copy_to(const std::vector<T1>& a, std::vector<T2>& b, size_t from_idx=0, size_t to_idx=0){
 		size_t N = ((a.size()-from_idx) > (b.size()-to_idx))? (b.size()-to_idx) : (a.size()-from_idx);
 		for(size_t i=0; i<N; ++i){
 			b[i+to_idx] = a[i+from_idx];
@@ -1020,8 +1021,8 @@ namespace data_utils{
 		}
 	}
 
-	template<class T>
-	void copy_as_real(const std::vector<T>& source, std::vector<std::complex<T>>& complex_dest){
+	template<class T1, class T2>
+	void copy_as_real(const std::vector<T1>& source, std::vector<std::complex<T2>>& complex_dest){
 		assert(source.size() == complex_dest.size());
 		for(size_t i=0; i<source.size(); ++i){
 			complex_dest[i].real(source[i]);
@@ -1038,8 +1039,8 @@ namespace data_utils{
 		return;
 	}
 
-	template<class T>
-	void copy_from_real(const std::vector<std::complex<T>>& source, std::vector<T>& real_dest){
+	template<class T1, class T2>
+	void copy_from_real(const std::vector<std::complex<T1>>& source, std::vector<T2>& real_dest){
 		assert(source.size() == real_dest.size());
 		for(size_t i=0; i<source.size(); ++i){
 			real_dest[i] = source[i].real();
@@ -353,7 +353,22 @@ void send_data_to_plot(
 // * Should pre-allocate as much as possible. Ideally will be able to give JS side a chunk of memory
 //   where in-progress plot data will be written and have it update the plots in a loop.
 // * May need to run the C++ side in a web-worker.
-CleanModifiedAlgorithm::CleanModifiedAlgorithm(
+Deconvolver::Deconvolver():
+		data_size(0),
+		data_shape(),
+		data_shape_adjustment(0),
+		n_channels(1),
+		tag(""),
+		fft_plan_rigor(PlanRigor::ESTIMATE),
+		n_fft_threads(1),
+		plot_update_interval(0),
+		running(false),
+		paused(false)
+{
+}
+
+
+CleanModifiedAlgorithmBase::CleanModifiedAlgorithmBase(
 		size_t _n_iter,
 		size_t _n_positive_iter,
 		double _loop_gain,
@@ -364,6 +379,7 @@ CleanModifiedAlgorithm::CleanModifiedAlgorithm(
 		double _rms_frac_threshold,
 		double _fabs_frac_threshold
 	): 
+		Deconvolver(),
 		n_iter(_n_iter), 
 		n_positive_iter(_n_positive_iter), 
 		loop_gain(_loop_gain),
@@ -373,53 +389,201 @@ CleanModifiedAlgorithm::CleanModifiedAlgorithm(
 		noise_std(_noise_std), 
 		rms_frac_threshold(_rms_frac_threshold), 
 		fabs_frac_threshold(_fabs_frac_threshold),
-		plot_update_interval(0),
-		data_size(0),
-		data_shape(),
-		residual_data(0), 
-		components_data(0), 
+		update_mode("hybrid"),
+		fft_tile_size(TiledConvolver<>::default_tile_size),
+		separable_psf_error(1E-3),
+		psf_support_threshold(0.0),
+		psf_symmetry_tolerance(1E-3),
+		clark_psf_patch_threshold(0.1),
+		clark_max_minor_iter(1000),
+		clark_stop_on_rms_increase(true),
+		multiscale_sigmas({0, 2, 4, 8}),
+		multiscale_bias(0.3),
+		multiscale_support_threshold(1E-3),
+		multiscale_refresh_interval(100),
+		richardson_lucy_acceleration(true),
+		fista_l1_weight(1E-2),
+		fista_positive(true),
+		preview_regularisation(1E-2),
 		px_choice_map(0),
-		data_shape_adjustment(0),
-		padded_psf_data(0), 
-		selected_pixels(0), 
-		current_convolved(0),
+		px_threshold(0),
+		n_selected_pixels(0),
+		selected_box_offset(2, 0),
+		selected_box_shape(2, 0),
+		psf_stamp_shape(0),
+		psf_stamp_offset(0),
+		direct_update_max_pixels(0),
 		fabs_record(_n_iter), 
 		rms_record(_n_iter),
 		threshold_record(_n_iter),
 		histogram_n_bins(100),
 		histogram_edges(histogram_n_bins),
 		histogram_counts(histogram_n_bins),
-		temp_data(0),
-		fft(), 
-		ifft(), 
-		psf_fft(), 
-		selected_px_fft(), 
-		tag("")
+		otsu_n_bins(256),
+		otsu_histogram(otsu_n_bins),
+		n_iter_done(0),
+		stopping_criteria_met(false)
 {
 }
 
+bool Deconvolver::handles_all_channels() const {
+	return false;
+}
+
+// Sections start at multiples of 8 bytes
+uint64_t checkpoint_padded_bytes(uint64_t n_bytes){
+	return (n_bytes + 7) & ~uint64_t(7);
+}
+
+size_t checkpoint_section_offset(const CheckpointHeader& header, CheckpointSection section){
+	auto padded = checkpoint_padded_bytes;
+	const size_t frame_bytes = padded(header.data_shape[0]*header.data_shape[1]*header.value_size);
+	const size_t psf_bytes = padded(header.psf_shape[0]*header.psf_shape[1]*header.value_size);
+	const size_t record_bytes = header.n_iter_done*sizeof(double);
+	const size_t section_bytes[] = {frame_bytes, frame_bytes, psf_bytes, record_bytes, record_bytes, record_bytes};
+
+	size_t offset = padded(sizeof(CheckpointHeader));
+	for(size_t k=0; k<static_cast<size_t>(section); ++k){
+		offset += section_bytes[k];
+	}
+	return offset;
+}
+
+bool checkpoint_fits(const CheckpointHeader& header, size_t n_bytes){
+	const uint64_t max_bytes = n_bytes;
+	uint64_t total = checkpoint_padded_bytes(sizeof(CheckpointHeader));
+	// Adds 'n_sections' sections of 'a*b*c' bytes to 'total', false when they do not fit
+	auto add_sections = [&](uint64_t n_sections, uint64_t a, uint64_t b, uint64_t c){
+		if (((b != 0) && (a > max_bytes/b)) || ((c != 0) && (a*b > max_bytes/c))){
+			return false;
+		}
+		const uint64_t section_bytes = checkpoint_padded_bytes(a*b*c);
+		for(uint64_t k=0; k<n_sections; ++k){
+			if ((total > max_bytes) || (section_bytes > max_bytes - total)){
+				return false;
+			}
+			total += section_bytes;
+		}
+		return true;
+	};
+	return (total <= max_bytes)
+		&& add_sections(2, header.data_shape[0], header.data_shape[1], header.value_size)
+		&& add_sections(1, header.psf_shape[0], header.psf_shape[1], header.value_size)
+		&& add_sections(3, header.n_iter_done, 1, sizeof(double));
+}
+
+bool Deconvolver::supports_checkpoints() const {
+	return false;
+}
+
+std::vector<std::byte> Deconvolver::save_checkpoint() const {
+	GET_LOGGER;
+	LOG_WARN("This deconvolver cannot save checkpoints");
+	return {};
+}
+
+bool Deconvolver::resume_from_checkpoint([[maybe_unused]] std::span<const std::byte> checkpoint){
+	GET_LOGGER;
+	LOG_WARN("This deconvolver cannot resume from checkpoints");
+	return false;
+}
+
+void Deconvolver::pause(){
+	paused = running;
+}
+
+void Deconvolver::prepare_preview(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag
+	){
+	prepare_observations(obs_data, obs_shape, psf_data, psf_shape, run_tag);
+}
+
+void Deconvolver::preview(){
+	GET_LOGGER;
+	LOG_WARN("This deconvolver cannot make previews, the clean map is unchanged");
+}
+
+size_t Deconvolver::n_extra_clean_maps() const {
+	return 0;
+}
+
+std::vector<double> Deconvolver::get_extra_clean_map(size_t k) const {
+	return {};
+}
+
+
+bool CleanModifiedAlgorithmBase::_use_direct_update() const {
+	if (update_mode == "direct"){
+		return true;
+	}
+	if (update_mode == "hybrid"){
+		return n_selected_pixels <= direct_update_max_pixels;
+	}
+	return false;
+}
+
+bool CleanModifiedAlgorithmBase::_uses_psf_spectrum() const {
+	return (update_mode != "tiled") && (update_mode != "separable");
+}
+
+
+template<class T>
+std::string CleanModifiedAlgorithm<T>::precision() const {
+	return FFTPrecision<T>::name;
+}
+
+template<class T>
+std::string CleanModifiedAlgorithm<T>::type_name() const {
+	return "clean_modified";
+}
+
+template<class T>
+std::vector<double> CleanModifiedAlgorithm<T>::get_clean_map() const {
+	return du::as_type<double>(clean_map);
+}
+
+template<class T>
+std::vector<double> CleanModifiedAlgorithm<T>::get_residual() const {
+	return du::as_type<double>(residual_data);
+}
 
+template<class T>
+size_t CleanModifiedAlgorithm<T>::n_extra_clean_maps() const {
+	return extra_clean_maps.size();
+}
 
+template<class T>
+std::vector<double> CleanModifiedAlgorithm<T>::get_extra_clean_map(size_t k) const {
+	return du::as_type<double>(extra_clean_maps[k]);
+}
 
-void CleanModifiedAlgorithm::_get_residual_from_obs(const std::vector<double>& obs_data, const std::vector<size_t>& obs_shape){
+template<class T>
+void CleanModifiedAlgorithm<T>::_get_residual_from_obs(const std::vector<T>& obs_data, const std::vector<size_t>& obs_shape){
 	GET_LOGGER;
 	std::vector<bool> obs_nan_mask(obs_data.size());
 	residual_data = obs_data;
 	LOGV_DEBUG(obs_data.size(), obs_nan_mask.size(), residual_data.size());
 
-	obs_nan_mask = du::mask_where(residual_data, std::function<bool(double)>(du::isnan<double>));
-	du::set_at_mask(residual_data, obs_nan_mask, 0.0);
+	obs_nan_mask = du::mask_where(residual_data, std::function<bool(T)>(du::isnan<T>));
+	du::set_at_mask(residual_data, obs_nan_mask, T(0));
+	residual_peaks.set_shape(obs_shape);
+	residual_peaks.refresh(residual_data);
 }
 
-void CleanModifiedAlgorithm::_get_padded_psf(
-		const std::vector<double>& psf_data, 
+template<class T>
+std::vector<T> CleanModifiedAlgorithm<T>::_get_padded_psf(
+		const std::vector<T>& psf_data, 
 		const std::vector<size_t>& psf_shape,
-		const std::string& centering_mode = "center_of_brightness"
-	){
+		const std::string& centering_mode
+	) const {
 	GET_LOGGER;
 
-	// zero the array that will hold our result
-	du::multiply_inplace(padded_psf_data, 0);
+	// zeroed array that will hold our result
+	std::vector<T> padded_psf(data_size, T(0));
 
 	// define the first pixel that psf_data will be written from 
 	std::vector<size_t> psf_fpixel(psf_shape.size(),0); // from (0,0)
@@ -436,14 +600,14 @@ void CleanModifiedAlgorithm::_get_padded_psf(
 
 
 	LOG_DEBUG("Copying PSF data to padded array");
-	du::copy_to_rect(psf_data, padded_psf_data, psf_shape, data_shape, psf_fpixel, psf_fpixel_obs);
-	du::write_as_image(_sprintf("./plots/%psf_padded_before.pgm", tag), padded_psf_data, data_shape);
+	du::copy_to_rect(psf_data, padded_psf, psf_shape, data_shape, psf_fpixel, psf_fpixel_obs);
+	du::write_as_image(_sprintf("./plots/%psf_padded_before.pgm", tag), padded_psf, data_shape);
 
-	LOG_DEBUG("Removing NANs from padded_psf_data");
-	// remove NANs from padded_psf_data
-	std::vector<bool> psf_nan_mask = du::mask_where(padded_psf_data, std::function<bool(double)>(du::isnan<double>));
-	du::set_at_mask(padded_psf_data, psf_nan_mask, 0.0);
-	du::multiply_inplace(padded_psf_data, 1.0/du::sum(padded_psf_data));
+	LOG_DEBUG("Removing NANs from padded_psf");
+	// remove NANs from padded_psf
+	std::vector<bool> psf_nan_mask = du::mask_where(padded_psf, std::function<bool(T)>(du::isnan<T>));
+	du::set_at_mask(padded_psf, psf_nan_mask, T(0));
+	du::multiply_inplace(padded_psf, 1.0/du::sum(padded_psf));
 
 	std::vector<int> center_offset_nd_idx(data_shape.size(), 0);
 	
@@ -452,14 +616,15 @@ void CleanModifiedAlgorithm::_get_padded_psf(
 	}
 	if(centering_mode == "center_of_brightness"){
 		LOG_INFO("Centering PSF by center of brightness");
+		// round to the nearest pixel, truncating can put a symmetric PSF one pixel off center
 		center_offset_nd_idx = du::subtract(
 			du::as_type<int>(du::ratio(data_shape, 2)),
-			du::as_type<int>(du::idx_moment_1(padded_psf_data, data_shape))
+			du::as_type<int>(du::add(du::idx_moment_1(padded_psf, data_shape), 0.5))
 		);
 	}
 	else if(centering_mode == "brightest_pixel"){
 		LOG_INFO("Centering PSF by brightest pixel");
-		size_t center_offset_1d_idx = du::idx_max(padded_psf_data);
+		size_t center_offset_1d_idx = du::idx_max(padded_psf);
 		center_offset_nd_idx = du::subtract(
 			du::as_type<int>(du::ratio(data_shape, 2)),
 			du::as_type<int>(du::index_1d_to_nd(data_shape, center_offset_1d_idx))
@@ -470,30 +635,101 @@ void CleanModifiedAlgorithm::_get_padded_psf(
 	}
 	LOGV_DEBUG(center_offset_nd_idx);
 
-	// If there is no shift from the center, don't bother
-	if (!du::is_identical(center_offset_nd_idx, du::zeros<int>(center_offset_nd_idx.size()))){
-		du::shift_inplace(
-			padded_psf_data, 
-			data_shape, 
-			center_offset_nd_idx
-		);
+	LOG_DEBUG("Adjusting padded_psf for convolution centering");
+	// Re-center the padded_psf so that the convolution in "run()" 
+	// is performed in the correct way.
+	// Because of how fftw works, need to align on 0th pixel
+	// we DO NOT want the PSF to be centered in it's frame, so the center
+	// (data_shape/2 after the offset above) is moved to pixel 0 in the same shift.
+	// Each axis is shifted separately, so this works whether the axes are odd or even.
+	du::subtract_inplace(center_offset_nd_idx, du::as_type<int>(du::ratio(data_shape, 2)));
+	LOGV_DEBUG(center_offset_nd_idx);
+	du::shift_inplace(
+		padded_psf, 
+		data_shape, 
+		center_offset_nd_idx
+	);
+	LOGV_DEBUG(padded_psf.size(), du::idx_max(padded_psf));
+	return padded_psf;
+}
+
+template<class T>
+double CleanModifiedAlgorithm<T>::_get_psf_asymmetry(const std::vector<T>& padded_psf) const {
+	// The PSF is centred on pixel 0, so its reflection takes (x,y) to (-x,-y) modulo the shape
+	const size_t nx = data_shape[0];
+	const size_t ny = data_size/nx;
+	double max_diff = 0;
+	for(size_t y=0; y<ny; ++y){
+		const size_t ry = (ny - y)%ny;
+		for(size_t x=0; x<nx; ++x){
+			const size_t rx = (nx - x)%nx;
+			max_diff = std::max(max_diff, std::fabs(static_cast<double>(padded_psf[x + y*nx]) - padded_psf[rx + ry*nx]));
+		}
 	}
+	const double psf_absmax = du::absmax(padded_psf);
+	return (psf_absmax > 0) ? max_diff/psf_absmax : 0;
+}
 
-	LOG_DEBUG("Adjusted padded_psf_data for convolution centering");
-	// Re-center the padded_psf_data so that the convolution in "run()" 
-	// is performed in the correct way.
-	std::vector<double> delta_f(psf_fft.size(), 0);
+template<class T>
+void CleanModifiedAlgorithm<T>::_prepare_psf(
+		const std::vector<T>& psf_data, 
+		const std::vector<size_t>& psf_shape,
+		bool needs_spectrum,
+		const std::string& centering_mode
+	){
+	GET_LOGGER;
+	const PSFCache::Key key = PSFCache::make_key(psf_data, psf_shape, data_shape, centering_mode);
+	std::shared_ptr<const PSFCache::Entry<T>> cached = PSFCache::find(key, psf_data);
 
-	LOGV_DEBUG(padded_psf_data.size());
-	LOGV_DEBUG(psf_fft.size(), delta_f.size(), du::idx_max(padded_psf_data));
+	PSFCache::Entry<T> entry;
+	if (cached){
+		entry = *cached;
+	} else {
+		entry.psf_data = psf_data;
+		entry.padded_psf_data = std::make_shared<const std::vector<T>>(_get_padded_psf(psf_data, psf_shape, centering_mode));
+		entry.asymmetry = _get_psf_asymmetry(*entry.padded_psf_data);
+	}
+	psf_is_symmetric = (entry.asymmetry <= psf_symmetry_tolerance);
+	LOGV_DEBUG(entry.asymmetry, psf_is_symmetric);
+
+	padded_psf_data = entry.padded_psf_data;
+	psf_fft = nullptr;
+	psf_fft_real = nullptr;
+	if (!needs_spectrum){
+		if (!cached){
+			PSFCache::insert(key, std::move(entry));
+		}
+		return;
+	}
 
-	// Because of how fftw works, need to align on 0th pixel
-	// we DO NOT want the PSF to be centered in it's frame
-	du::shift_inplace(padded_psf_data, padded_psf_data.size()/2);
-	
+	if (cached && (psf_is_symmetric ? bool(cached->psf_fft_real) : bool(cached->psf_fft))){
+		LOG_DEBUG("Using cached PSF");
+		psf_fft = psf_is_symmetric ? nullptr : cached->psf_fft;
+		psf_fft_real = psf_is_symmetric ? cached->psf_fft_real : nullptr;
+		return;
+	}
+
+	LOG_DEBUG("precompute PSF FFT");
+	std::vector<complex> spectrum(fft.spectrum_size);
+	fft.execute(*entry.padded_psf_data, spectrum);
+	ifft.normalise_spectrum(spectrum);
+	if (psf_is_symmetric){
+		// The imaginary part is the spectrum of the antisymmetric part, which is within tolerance of zero
+		std::vector<T> spectrum_real(spectrum.size());
+		for(size_t i=0; i<spectrum.size(); ++i){
+			spectrum_real[i] = spectrum[i].real();
+		}
+		entry.psf_fft_real = std::make_shared<const std::vector<T>>(std::move(spectrum_real));
+		psf_fft_real = entry.psf_fft_real;
+	} else {
+		entry.psf_fft = std::make_shared<const std::vector<complex>>(std::move(spectrum));
+		psf_fft = entry.psf_fft;
+	}
+	PSFCache::insert(key, std::move(entry));
 }
 
-void CleanModifiedAlgorithm::__str__(){
+template<class T>
+void CleanModifiedAlgorithm<T>::__str__(){
 	GET_LOGGER;
 	LOGV_DEBUG(n_iter);
 	LOGV_DEBUG(n_positive_iter);
@@ -509,104 +745,321 @@ void CleanModifiedAlgorithm::__str__(){
 	LOGV_DEBUG(px_choice_map);
 }
 
-void CleanModifiedAlgorithm::_calc_pixel_threshold(){
+template<class T>
+void CleanModifiedAlgorithm<T>::_calc_pixel_threshold(){
 	//px_threshold = threshold * du::max(residual_data);
 	if (threshold > 0){
 		// Static threshold as a fraction of brightest pixel of the residual
-		px_threshold = threshold * du::absmax(residual_data);
+		px_threshold = threshold * residual_peaks.absmax();
 	}
 	else {
-		//puts("NOTE: Using Otsu's method for thresholding");
-		// Otsu's method
-		// Minimises the intra-class variance (variance of pixels inside a class)
-		//
-		// probability of in bin i of histogram, p_i = f_i/N, f_i is number of pixels in bin i, N is total number of pixels
-		// for class 'c' with boundaries [t0,t1), mean of class is sum(p_i*x(i)) from i(t0) to i(t1), 
-		// where i(x) gets the histogram bin of value x, and x(i) is the midpoint value of histogram bin i.
-		// u_c = Sum(x(i)*p_i)_{i_0}^{i_1}/(i_1-i_0)
-		// variance is averange square distance from mean
-		// sigma_c^2 = sum( p_i*(x(i)-u_c)^2 )
-		//           = sum( p_i*(x(i)^2 -2*x(i)*u_c + u_c^2) )
-		//           = sum( p_i*x(i)^2 -2*p_i*x(i)*u_c + p_i*u_c^2)
-				
-		// sort based on indices
-		std::sort(indices.data(), indices.data()+indices.size(), [this](const short a, const short b)->bool{return (residual_data[a] < residual_data[b]);});
-		
-		
-		
-		//std::vector<double> class_sum_prob(indices.data());
-		//std::vector<double> class_mean(indices.data());
-		double total_mean = 0;
-		double p_i = 1.0/indices.size();
-		for(const double x : residual_data){
-			total_mean += p_i*x;
+		// Otsu's method on a histogram of |residual|
+		// Chooses the bin edge that maximises the between-class variance
+		//     w_0*w_1*(u_0 - u_1)^2
+		// which is the same as minimising the intra-class variance. w_c is the fraction of
+		// pixels in class 'c', and u_c is their mean, taken from bin midpoints. Building the
+		// histogram is one pass over the pixels, the search is one pass over the bins.
+		const double absmax = std::abs(residual_peaks.absmax());
+		if (absmax == 0){
+			px_threshold = 0;
+			return;
 		}
-		
-		double cumulative_prob = 0;
-		double cumulative_value = 0;
-		double cumulative_mean = 0;
-		double class_1_adj_prob = 0;
-		double class_1_sigma = 0, class_2_sigma=0;
-		double intra_class_variance = 0;
-		double min_intra_class_variance = 1E300; // very large number
-		short min_threshold_index = 0;
-		for(short i=0; i<indices.size(); ++i){
-			cumulative_value += residual_data[i];
-			cumulative_prob += p_i;
-			class_1_adj_prob = (p_i/cumulative_prob);
-			cumulative_mean += class_1_adj_prob*cumulative_value;
-			class_1_sigma = 0;
-			class_2_sigma = 0;
-			for(short j=0; i< indices.size(); ++j){
-				class_1_sigma += class_1_adj_prob*(residual_data[i] - cumulative_mean)*(residual_data[i] - cumulative_mean);
-				class_2_sigma += p_i/(1-cumulative_prob)*(residual_data[i] - (total_mean - cumulative_mean))*(residual_data[i] - (total_mean - cumulative_mean));
-				
+		const double bin_width = absmax/otsu_n_bins;
+		const double bins_per_unit = otsu_n_bins/absmax;
+		const size_t last_bin = otsu_n_bins - 1;
+
+		du::set_to(otsu_histogram, 0);
+		for(const T x : residual_data){
+			const size_t bin = static_cast<size_t>(std::abs(x)*bins_per_unit);
+			++otsu_histogram[std::min(bin, last_bin)];
+		}
+
+		// Sums over bins are in units of bins, scaled by 'bin_width' at the end
+		double total_sum = 0;
+		for(size_t i=0; i<otsu_n_bins; ++i){
+			total_sum += otsu_histogram[i]*(i + 0.5);
+		}
+		const double n_total = residual_data.size();
+
+		double n_below = 0;
+		double sum_below = 0;
+		double max_between_class_variance = -1;
+		size_t threshold_bin = 0;
+		for(size_t i=0; i<last_bin; ++i){
+			n_below += otsu_histogram[i];
+			sum_below += otsu_histogram[i]*(i + 0.5);
+			const double n_above = n_total - n_below;
+			if ((n_below == 0) || (n_above == 0)){
+				continue;
 			}
-			intra_class_variance = cumulative_prob*class_1_sigma + (1-cumulative_prob)*class_2_sigma;
-			if (intra_class_variance < min_intra_class_variance){
-				min_threshold_index = i;
+			const double mean_diff = sum_below/n_below - (total_sum - sum_below)/n_above;
+			const double between_class_variance = n_below*n_above*mean_diff*mean_diff;
+			if (between_class_variance > max_between_class_variance){
+				max_between_class_variance = between_class_variance;
+				threshold_bin = i;
 			}
 		}
-		
-		px_threshold = residual_data[min_threshold_index];
+
+		// upper edge of the last bin in the lower class
+		px_threshold = (threshold_bin + 1)*bin_width;
 	}
 }
 
-void CleanModifiedAlgorithm::_select_update_pixels(){
+template<class T>
+void CleanModifiedAlgorithm<T>::_select_update_pixels(){
+	GET_LOGGER;
+	const size_t nx = data_shape[0], ny = data_size/nx;
+	const T t = px_threshold;
+	const T gain = loop_gain;
+
+	// Clear last iteration's selection, only tiles holding a pixel above the threshold
+	// can have anything selected this iteration.
+	for(size_t k : selected_tiles){
+		const std::array<size_t,2> offset = residual_peaks.tile_offset(k);
+		const std::array<size_t,2> extent = residual_peaks.tile_extent(k);
+		for(size_t y=offset[1]; y<offset[1]+extent[1]; ++y){
+			std::fill_n(selected_pixels.data() + offset[0] + y*nx, extent[0], T(0));
+		}
+	}
+	selected_tiles = residual_peaks.tiles_above(t);
+
+	size_t x_min = nx, x_max = 0, y_min = ny, y_max = 0;
+	n_selected_pixels = 0;
+	for(size_t k : selected_tiles){
+		const std::array<size_t,2> offset = residual_peaks.tile_offset(k);
+		const std::array<size_t,2> extent = residual_peaks.tile_extent(k);
+		const size_t x_end = offset[0] + extent[0];
+		for(size_t y=offset[1]; y<offset[1]+extent[1]; ++y){
+			const T* in_row = residual_data.data() + y*nx;
+			T* out_row = selected_pixels.data() + y*nx;
+			// Branch free so the compiler can vectorise it
+			size_t row_count = 0;
+			for(size_t x=offset[0]; x<x_end; ++x){
+				const bool is_selected = std::abs(in_row[x]) > t;
+				out_row[x] = is_selected ? gain*in_row[x] : T(0);
+				row_count += is_selected;
+			}
+			if (row_count == 0){
+				continue;
+			}
+			n_selected_pixels += row_count;
+			y_min = std::min(y_min, y);
+			y_max = std::max(y_max, y);
+			// Only rows with selected pixels are searched for the ends of the box
+			size_t x_first = offset[0];
+			while (!(std::abs(in_row[x_first]) > t)){
+				++x_first;
+			}
+			size_t x_last = x_end - 1;
+			while (!(std::abs(in_row[x_last]) > t)){
+				--x_last;
+			}
+			x_min = std::min(x_min, x_first);
+			x_max = std::max(x_max, x_last);
+		}
+	}
+
+	if (n_selected_pixels == 0){
+		selected_box_offset = {0, 0};
+		selected_box_shape = {0, 0};
+	} else {
+		selected_box_offset = {x_min, y_min};
+		selected_box_shape = {x_max - x_min + 1, y_max - y_min + 1};
+	}
+	LOGV_DEBUG(n_selected_pixels, selected_tiles.size(), selected_box_offset, selected_box_shape);
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_get_psf_stamp(){
+	_crop_psf(*padded_psf_data, psf_support_threshold, psf_stamp, psf_stamp_shape, psf_stamp_offset);
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_crop_psf(
+		const std::vector<T>& psf,
+		double support_threshold,
+		std::vector<T>& stamp,
+		std::vector<size_t>& stamp_shape,
+		std::vector<size_t>& stamp_offset
+	) const {
 	GET_LOGGER;
-	LOGV_DEBUG("Getting selected pixels");
-	px_choice_map = du::mask_where(
-		residual_data, 
-		std::function<bool(double)>(
-			[this](double v)->bool{
-				return(abs(v) > px_threshold);
+	assert(data_shape.size() == 2);
+	const size_t nx = data_shape[0], ny = data_shape[1];
+	const T cutoff = support_threshold*std::abs(du::absmax(psf));
+
+	// 'padded_psf_data' is centered on pixel 0 and wraps around, so find how far
+	// the support extends either side of pixel 0 along each axis.
+	size_t below_x=0, above_x=0, below_y=0, above_y=0;
+	for(size_t y=0; y<ny; ++y){
+		for(size_t x=0; x<nx; ++x){
+			if (std::abs(psf[x + y*nx]) <= cutoff){
+				continue;
+			}
+			if (x <= nx/2){
+				above_x = std::max(above_x, x);
+			} else {
+				below_x = std::max(below_x, nx-x);
+			}
+			if (y <= ny/2){
+				above_y = std::max(above_y, y);
+			} else {
+				below_y = std::max(below_y, ny-y);
+			}
+		}
+	}
+
+	stamp_offset = {below_x, below_y};
+	stamp_shape = {below_x + above_x + 1, below_y + above_y + 1};
+	LOGV_DEBUG(stamp_shape, stamp_offset);
+
+	stamp.resize(du::product(stamp_shape));
+	for(size_t j=0; j<stamp_shape[1]; ++j){
+		const size_t y = (j + ny - below_y) % ny;
+		for(size_t i=0; i<stamp_shape[0]; ++i){
+			const size_t x = (i + nx - below_x) % nx;
+			const T v = psf[x + y*nx];
+			stamp[i + j*stamp_shape[0]] = (std::abs(v) > cutoff) ? v : 0.0;
+		}
+	}
+}
+
+// Helper function
+// Adds 'value' times 'stamp' to 'data' with the stamp's pixel 'stamp_offset' on pixel {x0,y0},
+// wrapping around the edges of the frame
+template<class T>
+void add_stamp(
+		std::span<T> data, 
+		const std::vector<size_t>& data_shape, 
+		const std::vector<T>& stamp, 
+		const std::vector<size_t>& stamp_shape, 
+		const std::vector<size_t>& stamp_offset, 
+		size_t x0, 
+		size_t y0, 
+		T value
+	){
+	const size_t nx = data_shape[0], ny = data_shape[1];
+	const size_t sx = stamp_shape[0], sy = stamp_shape[1];
+	// Stamp rows are split in two where they wrap around the edge of the frame
+	const size_t x_start = (x0 + nx - stamp_offset[0]) % nx;
+	const size_t n_before_wrap = std::min(sx, nx - x_start);
+	size_t y = (y0 + ny - stamp_offset[1]) % ny;
+	for(size_t j=0; j<sy; ++j){
+		T* out_row = data.data() + y*nx;
+		const T* stamp_row = stamp.data() + j*sx;
+		for(size_t i=0; i<n_before_wrap; ++i){
+			out_row[x_start + i] += value*stamp_row[i];
+		}
+		for(size_t i=n_before_wrap; i<sx; ++i){
+			out_row[i - n_before_wrap] += value*stamp_row[i];
+		}
+		y = (y+1 == ny) ? 0 : y+1;
+	}
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_add_psf_stamps(std::span<const T> pixels, std::span<T> output) const {
+	std::fill(output.begin(), output.end(), T(0));
+	_add_psf_stamps(pixels, output, {0, 0}, data_shape);
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_add_psf_stamps(
+		std::span<const T> pixels, 
+		std::span<T> output, 
+		const std::vector<size_t>& box_offset, 
+		const std::vector<size_t>& box_shape
+	) const {
+	const size_t nx = data_shape[0];
+
+	for(size_t y0=box_offset[1]; y0<box_offset[1]+box_shape[1]; ++y0){
+		for(size_t x0=box_offset[0]; x0<box_offset[0]+box_shape[0]; ++x0){
+			const T v = pixels[x0 + y0*nx];
+			if (v == 0){
+				continue;
 			}
-		)
+			add_stamp(output, data_shape, psf_stamp, psf_stamp_shape, psf_stamp_offset, x0, y0, v);
+		}
+	}
+}
+
+// Crossover points depend only on the frame and stamp shapes, the number of FFT
+// threads, and the precision, so only measure them once
+static std::map<std::tuple<std::vector<size_t>, std::vector<size_t>, int, std::string>, size_t> direct_update_crossovers;
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_calibrate_update_cost(){
+	GET_LOGGER;
+	const auto shapes = std::make_tuple(data_shape, psf_stamp_shape, fft_n_threads(n_fft_threads), precision());
+	auto it = direct_update_crossovers.find(shapes);
+	if (it != direct_update_crossovers.end()){
+		direct_update_max_pixels = it->second;
+		LOGV_DEBUG(direct_update_max_pixels);
+		return;
+	}
+
+	// Time an update by repeating it until the total is long enough to measure
+	constexpr double min_seconds = 1E-3;
+	auto seconds_per_call = [](const std::function<void()>& update){
+		size_t n_calls = 0;
+		const auto start = std::chrono::steady_clock::now();
+		double elapsed = 0;
+		do {
+			update();
+			++n_calls;
+			elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while (elapsed < min_seconds);
+		return elapsed/n_calls;
+	};
+
+	// 'temp_data' holds spread out pixels, enough that adding their stamps takes about as
+	// long as scanning the frame. 'current_convolved' is overwritten by every update so
+	// can be used as the output.
+	const size_t n_sample = std::clamp<size_t>(data_size/du::product(psf_stamp_shape), 16, data_size);
+	du::set_to(temp_data, T(0));
+	double t_fixed = seconds_per_call([this](){_add_psf_stamps(temp_data, current_convolved);});
+	for(size_t k=0; k<n_sample; ++k){
+		temp_data[(k*data_size)/n_sample] = 1.0;
+	}
+	double t_sample = seconds_per_call([this](){_add_psf_stamps(temp_data, current_convolved);});
+	double t_fft = seconds_per_call([this](){_fft_convolve(temp_data, current_convolved);});
+
+	const double t_per_pixel = std::max(t_sample - t_fixed, 1E-12)/n_sample;
+	direct_update_max_pixels = std::min(
+		static_cast<size_t>(std::max(t_fft - t_fixed, 0.0)/t_per_pixel),
+		data_size
 	);
-	
-	
-	du::set_to(selected_pixels, 0.0);
-	du::set_at_mask(selected_pixels, px_choice_map, residual_data);
+	LOGV_DEBUG(t_fixed, t_per_pixel, t_fft, direct_update_max_pixels);
+
+	direct_update_crossovers[shapes] = direct_update_max_pixels;
 }
 
-std::pair<std::vector<double>, std::vector<size_t>> CleanModifiedAlgorithm::_ensure_odd(
-		const std::vector<double>& obs_data, 
-		const std::vector<size_t>& obs_shape
+std::vector<size_t> CleanModifiedAlgorithmBase::_get_working_shape(
+		const std::vector<size_t>& obs_shape,
+		const std::vector<size_t>& psf_shape
+	) const {
+	std::vector<size_t> working_shape(obs_shape.size());
+	for(size_t i=0; i<obs_shape.size(); ++i){
+		working_shape[i] = next_fast_fft_size(std::max(obs_shape[i], (i < psf_shape.size()) ? psf_shape[i] : 1));
+	}
+	return working_shape;
+}
+
+template<class T>
+std::pair<std::vector<T>, std::vector<size_t>> CleanModifiedAlgorithm<T>::_pad_to_working_shape(
+		const std::vector<T>& obs_data, 
+		const std::vector<size_t>& obs_shape,
+		const std::vector<size_t>& psf_shape
 	){
 	GET_LOGGER;
 	
-	LOG_DEBUG("Ensuring odd shape of input data");
+	LOG_DEBUG("Padding input data to an FFT friendly shape");
 	LOGV_DEBUG(obs_shape);
 	
-	data_shape_adjustment.resize(obs_shape.size());
-	for(size_t i=0; i<obs_shape.size(); ++i){
-		data_shape_adjustment[i] = 1-obs_shape[i]%2;
-	}
+	std::vector<size_t> new_obs_shape = _get_working_shape(obs_shape, psf_shape);
+	data_shape_adjustment = du::subtract(du::as_type<int>(new_obs_shape), du::as_type<int>(obs_shape));
 	LOGV_DEBUG(data_shape_adjustment);
-	
-	std::vector<size_t> new_obs_shape = du::add(obs_shape, data_shape_adjustment);
 
-	std::vector<double> new_obs_data(du::product(new_obs_shape), 0);
+	std::vector<T> new_obs_data(du::product(new_obs_shape), 0);
 	
 	std::vector<size_t> zero(obs_shape.size(),0);
 
@@ -619,7 +1072,44 @@ std::pair<std::vector<double>, std::vector<size_t>> CleanModifiedAlgorithm::_ens
 
 
 // Helper function
-void calculate_histogram(std::vector<double>& temp_data, std::vector<double>& histogram_edges, std::vector<uint32_t>& histogram_counts){
+// Zeros the rectangle of 'box_shape' at 'box_offset' in 'data', wrapping around the edges of the frame
+template<class T>
+void set_box_to_zero(std::span<T> data, const std::vector<size_t>& data_shape, const std::vector<size_t>& box_offset, const std::vector<size_t>& box_shape){
+	const size_t nx = data_shape[0], ny = data_shape[1];
+	const size_t n_before_wrap = std::min(box_shape[0], nx - box_offset[0]);
+	size_t y = box_offset[1];
+	for(size_t j=0; j<box_shape[1]; ++j){
+		T* row = data.data() + y*nx;
+		std::fill_n(row + box_offset[0], n_before_wrap, T(0));
+		std::fill_n(row, box_shape[0] - n_before_wrap, T(0));
+		y = (y+1 == ny) ? 0 : y+1;
+	}
+}
+
+// Helper function
+// A unit-sum gaussian with standard deviation 'sigma' centred on pixel 0 has transfer function
+// exp(-2 pi^2 sigma^2 |f|^2), separable in x and y. Sets its factor for the (nx/2+1)
+// non-negative x frequencies of an r2c spectrum, and for all ny y frequencies (those above
+// ny/2 are negative), 'y_scale' is folded into 'transfer_y'.
+template<class T>
+void set_gaussian_transfer_function(std::vector<T>& transfer_x, std::vector<T>& transfer_y, const std::vector<size_t>& data_shape, double sigma, double y_scale){
+	const size_t nx = data_shape[0], ny = data_shape[1];
+	transfer_x.resize(nx/2 + 1);
+	transfer_y.resize(ny);
+	const double a = -2*M_PI*M_PI*sigma*sigma;
+	for(size_t i=0; i<transfer_x.size(); ++i){
+		const double f = static_cast<double>(i)/nx;
+		transfer_x[i] = static_cast<T>(std::exp(a*f*f));
+	}
+	for(size_t j=0; j<ny; ++j){
+		const double f = static_cast<double>((j <= ny/2) ? j : ny-j)/ny;
+		transfer_y[j] = static_cast<T>(y_scale*std::exp(a*f*f));
+	}
+}
+
+// Helper function
+template<class T>
+void calculate_histogram(std::vector<T>& temp_data, std::vector<double>& histogram_edges, std::vector<uint32_t>& histogram_counts){
 	//histogram_edges.assign(0, histogram_edges.size());
 	//histogram_counts.assign(0, histogram_counts.size());
 	std::sort(temp_data.begin(), temp_data.end());
@@ -628,7 +1118,7 @@ void calculate_histogram(std::vector<double>& temp_data, std::vector<double>& hi
 	du::set_to(histogram_counts, 0);
 	// calculate histogram
 	size_t bin_idx = 0;
-	for(double a : temp_data){
+	for(T a : temp_data){
 		while(histogram_edges[bin_idx] < a){
 			++bin_idx;
 		}
@@ -650,24 +1140,38 @@ void send_to_canvas(const T& data, const std::vector<size_t>& data_shape, const
 	);
 }
 
-bool CleanModifiedAlgorithm::doIter(
+template<class T>
+bool CleanModifiedAlgorithm<T>::doIter(
 		size_t i
 	){
-	bool iter_continue = true;
-	
 	GET_LOGGER;
 	
 	LOGV_DEBUG(i);
 	
 	update_deconv_stats(i, -1);
 	
-	
+	_select_components();
+	_convolve_components();
+	return _apply_update(i);
+}
+
+template<class T>
+bool CleanModifiedAlgorithm<T>::_use_fft_update() const {
+	return _uses_psf_spectrum() && !_use_direct_update();
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_select_components(){
 	_calc_pixel_threshold();
 	
 	_select_update_pixels();
 	
 	if (false){
 		// Experimental scaling of loop gain based on compactness of selected pixels
+		px_choice_map = du::mask_where(
+			residual_data, 
+			std::function<bool(T)>([this](T v)->bool{return(std::abs(v) > px_threshold);})
+		);
 		std::vector<double> center_of_mass = du::idx_moment_1(px_choice_map, data_shape);
 		double bounding_circle_radius = du::bounding_circle_radius_of_mask(px_choice_map, data_shape, center_of_mass);
 		double compactness = du::sum<bool,double>(px_choice_map)/(M_PI*bounding_circle_radius*bounding_circle_radius);
@@ -684,26 +1188,114 @@ bool CleanModifiedAlgorithm::doIter(
 		printf("selected pixels factor %g\n", selected_signal_factor);
 		printf("modified loop_gain %g\n", modified_loop_gain);
 		
-		du::multiply_inplace(selected_pixels, modified_loop_gain);
+		// '_select_update_pixels()' has already applied 'loop_gain'
+		for(T& v : selected_pixels){
+			v *= modified_loop_gain/loop_gain;
+		}
+	}
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_convolve_components(){
+	if (_use_direct_update()){
+		// Only the stamps around the selected box are written, so only the region the
+		// last update wrote needs clearing
+		set_box_to_zero(current_convolved, data_shape, convolved_box_offset, convolved_box_shape);
+		_add_psf_stamps(selected_pixels, current_convolved, selected_box_offset, selected_box_shape);
+		for(size_t a=0; a<2; ++a){
+			convolved_box_offset[a] = (selected_box_offset[a] + data_shape[a] - psf_stamp_offset[a]) % data_shape[a];
+			convolved_box_shape[a] = (n_selected_pixels == 0) ? 0 : std::min(selected_box_shape[a] + psf_stamp_shape[a] - 1, data_shape[a]);
+		}
+		return;
+	}
+
+	if (update_mode == "tiled"){
+		tiled_convolver.convolve(selected_pixels, current_convolved);
+	} else if (update_mode == "separable"){
+		separable_convolver.convolve(selected_pixels, current_convolved);
 	} else {
-		du::multiply_inplace(selected_pixels, loop_gain);
+		_fft_convolve(selected_pixels, current_convolved);
 	}
-	selected_px_fft = fft(selected_pixels);
+	convolved_box_offset = {0, 0};
+	convolved_box_shape = data_shape;
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_fft_convolve(std::span<const T> pixels, std::span<T> output){
+	fft.execute(pixels, selected_px_fft);
+	if (psf_is_symmetric){
+		ifft.convolve(selected_px_fft, *psf_fft_real, output);
+	} else {
+		ifft.convolve(selected_px_fft, *psf_fft, output);
+	}
+}
 
-	current_convolved = du::real_part(ifft(du::multiply(selected_px_fft, psf_fft)));
+template<class T>
+void CleanModifiedAlgorithm<T>::_prepare_psf_adjoint(){
+	if (psf_is_symmetric){
+		psf_adjoint_fft = std::vector<complex>();
+		return;
+	}
+	// Reflection through pixel 0 conjugates the spectrum of real data
+	psf_adjoint_fft.resize(psf_fft->size());
+	std::transform(psf_fft->begin(), psf_fft->end(), psf_adjoint_fft.begin(), [](const complex& c){return std::conj(c);});
+}
 
-	du::subtract_inplace(residual_data, current_convolved);
-	du::add_inplace(components_data, selected_pixels);
+template<class T>
+void CleanModifiedAlgorithm<T>::_fft_convolve_adjoint(std::span<const T> pixels, std::span<T> output){
+	if (psf_is_symmetric){
+		_fft_convolve(pixels, output);
+		return;
+	}
+	fft.execute(pixels, selected_px_fft);
+	ifft.convolve(selected_px_fft, psf_adjoint_fft, output);
+}
 
-	
-	
-	fabs_record[i] = du::max(du::apply(residual_data, abs ));
-	rms_record[i] = sqrt(du::sum(du::apply(residual_data, du::square ))/residual_data.size());
+template<class T>
+bool CleanModifiedAlgorithm<T>::_apply_update(size_t i){
+	// 'current_convolved' and 'selected_pixels' are zero outside the convolved box, so only
+	// the tiles it overlaps change. Each tile's update and reductions are one pass.
+	const size_t nx = data_shape[0];
+	for(size_t k : residual_peaks.tiles_overlapping(convolved_box_offset, convolved_box_shape)){
+		const std::array<size_t,2> offset = residual_peaks.tile_offset(k);
+		const std::array<size_t,2> extent = residual_peaks.tile_extent(k);
+		// Extremes rather than the absolute value so the loop vectorises, squares
+		// accumulate in double whatever the working precision.
+		T tile_max = std::numeric_limits<T>::lowest();
+		T tile_min = std::numeric_limits<T>::max();
+		double tile_sum_of_squares = 0;
+		for(size_t y=offset[1]; y<offset[1]+extent[1]; ++y){
+			const size_t row_start = offset[0] + y*nx;
+			for(size_t idx=row_start; idx<row_start+extent[0]; ++idx){
+				const T r = residual_data[idx] - current_convolved[idx];
+				residual_data[idx] = r;
+				components_data[idx] += selected_pixels[idx];
+				tile_max = std::max(tile_max, r);
+				tile_min = std::min(tile_min, r);
+				const T r2 = r*r;
+				tile_sum_of_squares += r2;
+			}
+		}
+		residual_peaks.set_tile(k, tile_max, tile_min, tile_sum_of_squares);
+	}
+	residual_peaks.update_levels();
+
+	return _record_progress(i);
+}
+
+template<class T>
+bool CleanModifiedAlgorithm<T>::_record_progress(size_t i){
+	bool iter_continue = true;
+	GET_LOGGER;
+
+	fabs_record[i] = std::abs(residual_peaks.absmax());
+	rms_record[i] = sqrt(residual_peaks.sum_of_squares()/residual_data.size());
 	threshold_record[i] = px_threshold;
 	
-	// Check stoping criteria
-	if( i == (n_iter-1)){
-		iter_continue = false;
+	// Check stoping criteria. 'run()' stops after 'n_iter' iterations itself, that is not a
+	// criterion so a run continued with a larger 'n_iter' goes on from here.
+	const bool last_iter = (i+1 == n_iter);
+	if (last_iter){
 		LOG_INFO("Deconvolution finished maximum number of iterations (%).", i+1);
 	}
 	if( fabs_record[i] < fabs_record[0]*fabs_frac_threshold){
@@ -715,7 +1307,7 @@ bool CleanModifiedAlgorithm::doIter(
 		LOG_INFO("Deconvolution finished at % iterations. Root mean square of residual % is lower than threshold value %.", i+1,rms_record[i], rms_record[0]*rms_frac_threshold);
 	}
 	
-	if ((plot_update_interval > 0) && (!(i%plot_update_interval) || !iter_continue)){
+	if ((plot_update_interval > 0) && (!(i%plot_update_interval) || !iter_continue || last_iter)){
 		// NOTE: Plotting preparation etc. goes inside this if statement
 		size_t idx_start = i+1 - plot_update_interval;
 		size_t idx_end = i+1;
@@ -741,19 +1333,21 @@ bool CleanModifiedAlgorithm::doIter(
 		send_data_to_plot("component_histogram", "component_data", histogram_edges, histogram_counts);
 		
 		emscripten_sleep(1); // pass control back to javascript to allow event loop to run
-		temp_data = selected_pixels;
+		temp_data.assign(selected_pixels.begin(), selected_pixels.end());
 		calculate_histogram(temp_data, histogram_edges, histogram_counts);
 		send_data_to_plot("selected_pixels_histogram", "selected_pixels_data", histogram_edges, histogram_counts);
 		
 		emscripten_sleep(1); // pass control back to javascript to allow event loop to run
-		temp_data = current_convolved;
+		temp_data.assign(current_convolved.begin(), current_convolved.end());
 		calculate_histogram(temp_data, histogram_edges, histogram_counts);
 		send_data_to_plot("current_convolved_histogram", "current_convolved_data", histogram_edges, histogram_counts);
 		
 		emscripten_sleep(1); // pass control back to javascript to allow event loop to run
 		send_to_canvas(residual_data, data_shape, "inprogress-residual");
-		send_to_canvas(selected_pixels, data_shape, "inprogress-selected-pixels");
-		send_to_canvas(current_convolved, data_shape, "inprogress-current-convolved");
+		temp_data.assign(selected_pixels.begin(), selected_pixels.end());
+		send_to_canvas(temp_data, data_shape, "inprogress-selected-pixels");
+		temp_data.assign(current_convolved.begin(), current_convolved.end());
+		send_to_canvas(temp_data, data_shape, "inprogress-current-convolved");
 		send_to_canvas(components_data, data_shape, "inprogress-components");
 	}
 	
@@ -765,7 +1359,8 @@ bool CleanModifiedAlgorithm::doIter(
 	return iter_continue;
 }
 
-void CleanModifiedAlgorithm::prepare_observations(
+template<class T>
+void CleanModifiedAlgorithm<T>::prepare_observations(
 		const std::span<double> _input_obs_data, 
 		const std::span<size_t> _input_obs_shape, 
 		const std::span<double> _input_psf_data, 
@@ -776,62 +1371,101 @@ void CleanModifiedAlgorithm::prepare_observations(
 	LOG_DEBUG("declare variables");
 	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
 	
-	const std::vector<double> input_obs_data(std::cbegin(_input_obs_data), std::cend(_input_obs_data));
+	// Convert to the working precision
+	const std::vector<T> input_obs_data(std::cbegin(_input_obs_data), std::cend(_input_obs_data));
 	const std::vector<size_t> input_obs_shape(std::cbegin(_input_obs_shape), std::cend(_input_obs_shape));
-	const std::vector<double> input_psf_data(std::cbegin(_input_psf_data), std::cend(_input_psf_data));
-	const std::vector<size_t> input_psf_shape(std::cbegin(_input_psf_shape), std::cend(_input_psf_shape));
+	input_psf_data.assign(std::cbegin(_input_psf_data), std::cend(_input_psf_data));
+	input_psf_shape.assign(std::cbegin(_input_psf_shape), std::cend(_input_psf_shape));
 	
 	
 	
 	tag=run_tag;
 	data_shape_adjustment.resize(input_obs_shape.size());
 	
-	auto [adjusted_obs_data, adjusted_obs_shape ] = _ensure_odd(input_obs_data, input_obs_shape);
+	auto [adjusted_obs_data, adjusted_obs_shape ] = _pad_to_working_shape(input_obs_data, input_obs_shape, input_psf_shape);
 	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
 	
 	data_shape = adjusted_obs_shape;
 	data_size = du::product(data_shape);
 
+	_prepare_frames();
+
+	LOG_DEBUG("Getting residual from obs_data");
+	_get_residual_from_obs(adjusted_obs_data, data_shape);
+	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
+
+	_prepare_psf_state();
+	n_iter_done = 0;
+	stopping_criteria_met = false;
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_prepare_frames(){
+	GET_LOGGER;
 	LOG_DEBUG("resize dynamic arrays");
 	// resize arrays to hold desired data
-	padded_psf_data.resize(data_size);
-	psf_fft.resize(data_size);
-	selected_pixels.resize(data_size);
-	px_choice_map.resize(data_size);
-	selected_px_fft.resize(data_size);
-	current_convolved.resize(data_size);
+	owned_selected_pixels.resize(data_size);
+	owned_current_convolved.resize(data_size);
+	selected_pixels = owned_selected_pixels;
+	current_convolved = owned_current_convolved;
 	components_data.resize(data_size);
 	temp_data.resize(data_size);
 	
-	indices.resize(data_size);
-	for(short i=0; i<indices.size(); ++i){
-		indices[i] = i;
-	}
+	otsu_histogram.resize(otsu_n_bins);
 
 	du::multiply_inplace(components_data, 0);
+	// Selection and updates only clear what they wrote last, so start from empty frames
+	std::fill(selected_pixels.begin(), selected_pixels.end(), T(0));
+	selected_tiles.clear();
 
 	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
 
-	LOG_DEBUG("set FFT attributes");
-	// set attributes for fourier transformers
-	//fft.set_attrs(data_shape, false, true);
-	fft.set_attrs(data_shape, false, false);
-	LOG_DEBUG("forward fft attributes set");
-	//ifft.set_attrs(data_shape, true, true);
-	ifft.set_attrs(data_shape, true, false);
-	LOG_DEBUG("backward fft attributes set");
+	if (_uses_psf_spectrum()){
+		LOG_DEBUG("set FFT attributes");
+		// set attributes for fourier transformers
+		// plans are cached, so this only costs planning time for the first layer of a given shape
+		fft.set_attrs(data_shape, false, fft_plan_rigor, true, n_fft_threads);
+		LOG_DEBUG("forward fft attributes set");
+		ifft.set_attrs(data_shape, true, fft_plan_rigor, true, n_fft_threads);
+		LOG_DEBUG("backward fft attributes set");
+
+		// spectra of real data only need the non-redundant half
+		selected_px_fft.resize(fft.spectrum_size);
+	} else {
+		// no full-frame spectra are needed, release any left over from a previous layer
+		selected_px_fft = std::vector<complex>();
+	}
+}
 
-	LOG_DEBUG("Getting residual from obs_data");
-	_get_residual_from_obs(adjusted_obs_data, data_shape);
-	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
-	
+template<class T>
+void CleanModifiedAlgorithm<T>::_prepare_psf_state(bool calibrate){
+	GET_LOGGER;
 	LOG_DEBUG("Padding PSF data");
-	_get_padded_psf(input_psf_data, input_psf_shape);
+	// layers and images that share a PSF only pad and transform it once
+	_prepare_psf(input_psf_data, input_psf_shape, _uses_psf_spectrum());
 	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
-		
-	LOG_DEBUG("precompute PSF FFT");
-	// get the FFT of the PSF, will need it later
-	psf_fft = fft(padded_psf_data);
+
+	if (update_mode != "fft"){
+		LOG_DEBUG("Cropping PSF support for direct, tiled, and separable updates");
+		_get_psf_stamp();
+		if ((update_mode == "hybrid") && calibrate){
+			_calibrate_update_cost();
+		}
+		if (update_mode == "tiled"){
+			tiled_convolver.set_kernel(data_shape, psf_stamp, psf_stamp_shape, psf_stamp_offset, fft_tile_size, fft_plan_rigor, n_fft_threads);
+		}
+		if (update_mode == "separable"){
+			separable_convolver.set_kernel(data_shape, psf_stamp, psf_stamp_shape, psf_stamp_offset, separable_psf_error);
+			LOG_INFO("PSF approximated by % separable terms, relative error %", separable_convolver.rank, separable_convolver.relative_error);
+		}
+		emscripten_sleep(1); // pass control back to javascript to allow event loop to run
+	}
+
+	// Direct updates only clear the region the last update wrote, and calibration above
+	// may have written all of it
+	std::fill(current_convolved.begin(), current_convolved.end(), T(0));
+	convolved_box_offset = {0, 0};
+	convolved_box_shape = {0, 0};
 
 	// Clear plots
 	if (plot_update_interval > 0){
@@ -843,17 +1477,132 @@ void CleanModifiedAlgorithm::prepare_observations(
 
 
 
-void CleanModifiedAlgorithm::run(){
+template<class T>
+void CleanModifiedAlgorithm<T>::run(){
 	GET_LOGGER;
 	LOG_DEBUG("Starting deconvolution n_iter %", n_iter);
 
-	bool iter_continue = true;
+	timer::start();
+	running = true;
+	paused = false;
+	for(size_t i=n_iter_done; i<n_iter && !stopping_criteria_met && !paused; ++i){
+		stopping_criteria_met = !doIter(i);
+		n_iter_done = i+1;
+	}
+	running = false;
+	// A pause asked for during the last iteration does not stop anything
+	paused = paused && (n_iter_done < n_iter) && !stopping_criteria_met;
+	if (paused){
+		LOG_INFO("Paused after % iterations", n_iter_done);
+	}
+
+	_make_clean_map();
+
+	timer::stop();
+	LOGV_DEBUG(timer::n_seconds());
+}
 
+template<class T>
+void CleanModifiedAlgorithm<T>::prepare_preview(
+		const std::span<double> _input_obs_data, 
+		const std::span<size_t> _input_obs_shape, 
+		const std::span<double> _input_psf_data, 
+		const std::span<size_t> _input_psf_shape,
+		const std::string& run_tag
+	){
+	GET_LOGGER;
+	const std::vector<T> input_obs_data(std::cbegin(_input_obs_data), std::cend(_input_obs_data));
+	const std::vector<size_t> input_obs_shape(std::cbegin(_input_obs_shape), std::cend(_input_obs_shape));
+	input_psf_data.assign(std::cbegin(_input_psf_data), std::cend(_input_psf_data));
+	input_psf_shape.assign(std::cbegin(_input_psf_shape), std::cend(_input_psf_shape));
+
+	tag=run_tag;
+	data_shape_adjustment.resize(input_obs_shape.size());
+	auto [adjusted_obs_data, adjusted_obs_shape ] = _pad_to_working_shape(input_obs_data, input_obs_shape, input_psf_shape);
+	data_shape = adjusted_obs_shape;
+	data_size = du::product(data_shape);
+	_get_residual_from_obs(adjusted_obs_data, data_shape);
+
+	// plans are cached, so this only costs planning time for the first layer of a given shape
+	fft.set_attrs(data_shape, false, fft_plan_rigor, true, n_fft_threads);
+	ifft.set_attrs(data_shape, true, fft_plan_rigor, true, n_fft_threads);
+	_prepare_psf(input_psf_data, input_psf_shape, true);
+	n_iter_done = 0;
+	stopping_criteria_met = false;
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::preview(){
+	GET_LOGGER;
+	assert(data_shape.size() == 2);
+	if (n_iter_done > 0){
+		LOG_ERROR("Cannot preview after % iterations have been run, the clean map is unchanged. Prepare the observations again first.", n_iter_done);
+		return;
+	}
 	timer::start();
-	for(size_t i=0; i<n_iter && iter_continue; ++i){
-		iter_continue = doIter(i);
+
+	if (fft.size != data_size){
+		// "tiled" and "separable" modes do not set up the full-frame transformers
+		fft.set_attrs(data_shape, false, fft_plan_rigor, true, n_fft_threads);
+		ifft.set_attrs(data_shape, true, fft_plan_rigor, true, n_fft_threads);
+	}
+	std::vector<complex> obs_fft(fft.spectrum_size);
+	fft.execute(residual_data, obs_fft);
+
+	// PSF spectrum with the 1/data_size normalisation folded in, as 'psf_fft'. Only made here
+	// when the update mode did not prepare one.
+	const bool use_real_spectrum = (psf_fft_real != nullptr);
+	std::vector<complex> own_psf_fft;
+	if ((!use_real_spectrum) && (psf_fft == nullptr)){
+		own_psf_fft.resize(fft.spectrum_size);
+		fft.execute(*padded_psf_data, own_psf_fft);
+		ifft.normalise_spectrum(own_psf_fft);
+	}
+	const complex* psf_spectrum = use_real_spectrum ? nullptr : ((psf_fft == nullptr) ? own_psf_fft.data() : psf_fft->data());
+	auto psf_value = [&](size_t k) -> complex {
+		return use_real_spectrum ? complex((*psf_fft_real)[k], 0) : psf_spectrum[k];
+	};
+
+	double max_power = 0;
+	for(size_t k=0; k<fft.spectrum_size; ++k){
+		max_power = std::max(max_power, static_cast<double>(std::norm(psf_value(k))));
+	}
+	const double regularisation = preview_regularisation*max_power;
+	LOGV_DEBUG(max_power, regularisation);
+
+	// The PSF spectrum's normalisation is squared by the division, the inverse transform's
+	// normalisation is folded into 'transfer_y' with it.
+	const size_t nx = data_shape[0], ny = data_shape[1];
+	const size_t spectrum_nx = nx/2 + 1;
+	const double y_scale = 1.0/(static_cast<double>(data_size)*data_size);
+	std::vector<T> transfer_x, transfer_y;
+	if (clean_beam_gaussian_sigma > 0){
+		set_gaussian_transfer_function(transfer_x, transfer_y, data_shape, clean_beam_gaussian_sigma, y_scale);
+	} else {
+		transfer_x.assign(spectrum_nx, T(1));
+		transfer_y.assign(ny, static_cast<T>(y_scale));
+	}
+	for(size_t j=0; j<ny; ++j){
+		complex* row = obs_fft.data() + j*spectrum_nx;
+		for(size_t i=0; i<spectrum_nx; ++i){
+			const complex h = psf_value(i + j*spectrum_nx);
+			const double denominator = std::norm(h) + regularisation;
+			// Without regularisation, frequencies the PSF does not pass are left out
+			row[i] = (denominator > 0) ? row[i]*std::conj(h)*static_cast<T>(transfer_x[i]*transfer_y[j]/denominator) : complex(0);
+		}
 	}
 
+	clean_map.resize(data_size);
+	ifft.execute(obs_fft, clean_map);
+	extra_clean_maps.clear();
+
+	timer::stop();
+	LOGV_DEBUG(timer::n_seconds());
+}
+
+template<class T>
+void CleanModifiedAlgorithm<T>::_make_clean_map(){
+	GET_LOGGER;
 	LOGV_DEBUG(data_shape);
 
 	du::write_as_image(_sprintf("./plots/%components.pgm", tag), components_data, data_shape);
@@ -861,84 +1610,1121 @@ void CleanModifiedAlgorithm::run(){
 	du::write_as_image(_sprintf("./plots/%residual_log.pgm", tag), du::log(residual_data), data_shape);
 	
 	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
-	if (clean_beam_gaussian_sigma > 0){
-		LOG_DEBUG("Convolving result with gaussian clean beam with sigma=%", clean_beam_gaussian_sigma);
-		Eigen::MatrixXd Kernel(data_shape[0], data_shape[1]);
-		std::vector<FourierTransformer::complex> Kernel_fft(Kernel.size());
-		std::vector<FourierTransformer::complex> components_data_fft(Kernel.size());
-
-		Eigen::Matrix<double, 2,2> Sigma {	{1.0/(clean_beam_gaussian_sigma*clean_beam_gaussian_sigma), 0},
-											{0, 1.0/(clean_beam_gaussian_sigma*clean_beam_gaussian_sigma)}
-											};
-		
-		// As fftw produces non-centered FFTs, pos should be difference from center,
-		// however, will that account for everything correctly?
-		// I don't think so, I should really adjust the Kernel after it's created
-		// so that it is re-centered on (0,0) instead of (data_shape[0]/2, data_shape[1]/2).
-		//Eigen::Vector2d pos{0,0};
-		Eigen::Vector2d pos{data_shape[0]/2.0,data_shape[1]/2.0}; 
-		
-		Eigen::Vector2d idx {0,0};
-
-		for(int i=0;i < Kernel.rows(); idx[0]+=1, ++i){
-			emscripten_sleep(1); // pass control back to javascript to allow event loop to run
-			for(int j=0; j<Kernel.cols(); idx[1]+=1, ++j){
-				Kernel(i,j) = exp(-static_cast<double>((idx-pos).transpose() * Sigma * (idx-pos)));
-				//LOG_DEBUG("Kernel(%,%) = %",i,j,Kernel(i,j));
-				//LOGV_DEBUG(idx);
-				//LOGV_DEBUG(Sigma);
-				//LOGV_DEBUG(-static_cast<double>((idx-pos).transpose() * Sigma * (idx-pos)));
+	// All beams share one forward transform of the components
+	std::vector<double> sigmas{clean_beam_gaussian_sigma};
+	sigmas.insert(sigmas.end(), extra_clean_beam_sigmas.begin(), extra_clean_beam_sigmas.end());
+	std::vector<std::vector<T>> clean_maps = restore_clean_maps(sigmas);
+
+	clean_map = std::move(clean_maps[0]);
+	extra_clean_maps.assign(std::make_move_iterator(clean_maps.begin()+1), std::make_move_iterator(clean_maps.end()));
+
+	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
+	if(add_residual){
+		LOG_DEBUG("Adding residual to clean map");
+		du::add_inplace(clean_map, residual_data);
+		for(std::vector<T>& extra_clean_map : extra_clean_maps){
+			du::add_inplace(extra_clean_map, residual_data);
+		}
+	} else {
+		LOG_DEBUG("Residual NOT added to clean map");
+	}
+
+
+	du::write_as_image(_sprintf("./plots/%clean_map.pgm",tag), clean_map, data_shape);
+}
+
+template<class T>
+std::vector<std::vector<T>> CleanModifiedAlgorithm<T>::restore_clean_maps(const std::vector<double>& sigmas){
+	GET_LOGGER;
+	assert(data_shape.size() == 2);
+	std::vector<std::vector<T>> clean_maps(sigmas.size());
+
+	if (std::none_of(sigmas.begin(), sigmas.end(), [](double sigma){return sigma > 0;})){
+		LOG_DEBUG("Convolution with clean-beam not performed");
+		std::fill(clean_maps.begin(), clean_maps.end(), components_data);
+		return clean_maps;
+	}
+
+	if (fft.size != data_size){
+		// "tiled" and "separable" modes do not set up the full-frame transformers
+		fft.set_attrs(data_shape, false, fft_plan_rigor, true, n_fft_threads);
+		ifft.set_attrs(data_shape, true, fft_plan_rigor, true, n_fft_threads);
+	}
+	std::vector<complex> components_fft(fft.spectrum_size);
+	std::vector<complex> beam_fft(fft.spectrum_size);
+	fft.execute(components_data, components_fft);
+	LOGV_DEBUG(du::sum(components_data));
+
+	const size_t nx = data_shape[0], ny = data_shape[1];
+	const size_t spectrum_nx = nx/2 + 1;
+	std::vector<T> transfer_x, transfer_y;
+
+	for(size_t k=0; k<sigmas.size(); ++k){
+		const double sigma = sigmas[k];
+		if (sigma <= 0){
+			clean_maps[k] = components_data;
+			continue;
+		}
+		LOG_DEBUG("Convolving result with gaussian clean beam with sigma=%", sigma);
+
+		// The 1/data_size normalisation of the inverse transform is folded into 'transfer_y'
+		set_gaussian_transfer_function(transfer_x, transfer_y, data_shape, sigma, 1.0/data_size);
+		for(size_t j=0; j<ny; ++j){
+			const complex* in_row = components_fft.data() + j*spectrum_nx;
+			complex* out_row = beam_fft.data() + j*spectrum_nx;
+			for(size_t i=0; i<spectrum_nx; ++i){
+				out_row[i] = in_row[i]*(transfer_x[i]*transfer_y[j]);
 			}
-			idx[1] = 0;
 		}
-		
-		Kernel.array() /= sqrt(M_PI*M_PI/Sigma.determinant());
-		LOGV_DEBUG(Kernel.sum());
-		//LOGV_DEBUG(pos);
-	
-		du::write_as_image(_sprintf("./plots/%Kernel.pgm", tag), std::vector<double>(Kernel.data(), Kernel.data()+Kernel.size()), data_shape);
 
-		// TODO:
-		// * Re-center Kernel on (0,0) so that the fft-convolution doesn't go weird.
-		std::vector<double> temp(Kernel.size(), 0);
-		temp[temp.size() - (pos[0]*Kernel.colStride() + pos[1]*Kernel.rowStride())] = 1;
+		// complex-to-real transforms overwrite their input, 'beam_fft' is re-made for each beam
+		clean_maps[k].resize(data_size);
+		ifft.execute(beam_fft, clean_maps[k]);
+		LOGV_DEBUG(du::sum(clean_maps[k]));
+	}
+	return clean_maps;
+}
+
+template<class T>
+bool CleanModifiedAlgorithm<T>::supports_checkpoints() const {
+	return true;
+}
 
+// Fixed size, zero padded, text fields of 'CheckpointHeader'
+template<size_t N>
+void write_checkpoint_text(char (&field)[N], const std::string& text){
+	text.copy(field, N-1);
+}
 
-		Kernel_fft = fft(std::vector<double>(Kernel.data(), Kernel.data()+Kernel.size()));
-		du::write_as_image(_sprintf("./plots/%Kernel_fft_real.pgm", tag), du::real_part(Kernel_fft), data_shape);
-		du::write_as_image(_sprintf("./plots/%Kernel_fft_imag.pgm", tag), du::imag_part(Kernel_fft), data_shape);
-			
-		du::write_as_image(_sprintf("./plots/%Kernel_fft_ifft_real.pgm", tag), du::real_part(ifft(Kernel_fft)), data_shape);
-		du::write_as_image(_sprintf("./plots/%Kernel_fft_ifft_imag.pgm", tag), du::imag_part(ifft(Kernel_fft)), data_shape);
-		
-		components_data_fft = fft(components_data);
-		clean_map = du::real_part(ifft(du::multiply(components_data_fft, du::multiply(Kernel_fft,fft(temp)))));
-		LOGV_DEBUG(du::sum(components_data));
-		LOGV_DEBUG(du::max(components_data));
-		LOGV_DEBUG(du::sum(clean_map));
-		LOGV_DEBUG(du::max(clean_map));
+template<size_t N>
+std::string read_checkpoint_text(const char (&field)[N]){
+	return std::string(field, std::find(field, field + N, '\0'));
+}
+
+template<class T>
+std::vector<std::byte> CleanModifiedAlgorithm<T>::save_checkpoint() const {
+	GET_LOGGER;
+	if (!supports_checkpoints()){
+		return Deconvolver::save_checkpoint();
 	}
-	else {
-		LOG_DEBUG("Convolution with clean-beam not performed");
-		clean_map = components_data;
+	if (running){
+		LOG_ERROR("Cannot save a checkpoint part way through an iteration, pause the run first");
+		return {};
 	}
+	CheckpointHeader header{};
+	std::copy(std::begin(CheckpointHeader::expected_magic), std::end(CheckpointHeader::expected_magic), header.magic);
+	header.version = CheckpointHeader::current_version;
+	header.byte_order = CheckpointHeader::byte_order_mark;
+	header.value_size = sizeof(T);
+	header.stopping_criteria_met = stopping_criteria_met;
+	write_checkpoint_text(header.deconvolver_type, type_name());
+	for(size_t a=0; a<2; ++a){
+		header.data_shape[a] = data_shape[a];
+		header.data_shape_adjustment[a] = data_shape_adjustment[a];
+		header.psf_shape[a] = input_psf_shape[a];
+	}
+	header.n_iter_done = n_iter_done;
+
+	write_checkpoint_text(header.update_mode, update_mode);
+	header.n_positive_iter = n_positive_iter;
+	header.loop_gain = loop_gain;
+	header.threshold = threshold;
+	header.rms_frac_threshold = rms_frac_threshold;
+	header.fabs_frac_threshold = fabs_frac_threshold;
+	header.fft_tile_size = fft_tile_size;
+	header.separable_psf_error = separable_psf_error;
+	header.psf_support_threshold = psf_support_threshold;
+	header.psf_symmetry_tolerance = psf_symmetry_tolerance;
+	header.clark_psf_patch_threshold = clark_psf_patch_threshold;
+	header.clark_max_minor_iter = clark_max_minor_iter;
+	header.clark_stop_on_rms_increase = clark_stop_on_rms_increase;
+	header.direct_update_max_pixels = direct_update_max_pixels;
+
+	std::vector<std::byte> checkpoint(checkpoint_section_offset(header, CheckpointSection::END));
+	auto write_section = [&](CheckpointSection section, const void* values, size_t n_bytes){
+		std::memcpy(checkpoint.data() + checkpoint_section_offset(header, section), values, n_bytes);
+	};
+	std::memcpy(checkpoint.data(), &header, sizeof(header));
+	write_section(CheckpointSection::RESIDUAL, residual_data.data(), data_size*sizeof(T));
+	write_section(CheckpointSection::COMPONENTS, components_data.data(), data_size*sizeof(T));
+	write_section(CheckpointSection::PSF, input_psf_data.data(), input_psf_data.size()*sizeof(T));
+	write_section(CheckpointSection::FABS_RECORD, fabs_record.data(), n_iter_done*sizeof(double));
+	write_section(CheckpointSection::RMS_RECORD, rms_record.data(), n_iter_done*sizeof(double));
+	write_section(CheckpointSection::THRESHOLD_RECORD, threshold_record.data(), n_iter_done*sizeof(double));
+	LOGV_DEBUG(data_shape, n_iter_done, checkpoint.size());
+	return checkpoint;
+}
+
+template<class T>
+bool CleanModifiedAlgorithm<T>::resume_from_checkpoint(std::span<const std::byte> checkpoint){
+	GET_LOGGER;
+	if (!supports_checkpoints()){
+		return Deconvolver::resume_from_checkpoint(checkpoint);
+	}
+	if (running){
+		LOG_ERROR("Cannot resume from a checkpoint while a run is in progress");
+		return false;
+	}
+	CheckpointHeader header;
+	if (checkpoint.size() < sizeof(header)){
+		LOG_WARN("Checkpoint of % bytes is too small to hold its header", checkpoint.size());
+		return false;
+	}
+	std::memcpy(&header, checkpoint.data(), sizeof(header));
+	if (!std::equal(std::begin(CheckpointHeader::expected_magic), std::end(CheckpointHeader::expected_magic), header.magic)){
+		LOG_WARN("Data is not a deconvolver checkpoint");
+		return false;
+	}
+	if (header.version != CheckpointHeader::current_version){
+		LOG_WARN("Checkpoint version % cannot be read, only version % can", header.version, CheckpointHeader::current_version);
+		return false;
+	}
+	if (header.byte_order != CheckpointHeader::byte_order_mark){
+		LOG_WARN("Checkpoint was written by a machine with a different byte order");
+		return false;
+	}
+	if (header.value_size != sizeof(T)){
+		LOG_WARN("Checkpoint has % byte values, this deconvolver's precision is '%'", header.value_size, precision());
+		return false;
+	}
+	const std::string checkpoint_type = read_checkpoint_text(header.deconvolver_type);
+	if (checkpoint_type != type_name()){
+		LOG_WARN("Checkpoint was saved by a '%' deconvolver, this one is '%'", checkpoint_type, type_name());
+		return false;
+	}
+	if (!checkpoint_fits(header, checkpoint.size())){
+		LOG_WARN("Checkpoint of % bytes is truncated, or its header is damaged", checkpoint.size());
+		return false;
+	}
+	// The PSF is centred in the frame, and the observation is the frame less its padding
+	for(size_t a=0; a<2; ++a){
+		if ((header.psf_shape[a] == 0) || (header.psf_shape[a] > header.data_shape[a])
+				|| (header.data_shape_adjustment[a] < 0) || (static_cast<uint64_t>(header.data_shape_adjustment[a]) >= header.data_shape[a])){
+			LOG_WARN("Checkpoint's shapes are damaged");
+			return false;
+		}
+	}
+	const std::string checkpoint_update_mode = read_checkpoint_text(header.update_mode);
+	if ((checkpoint_update_mode != "fft") && (checkpoint_update_mode != "direct") && (checkpoint_update_mode != "hybrid") && (checkpoint_update_mode != "tiled") && (checkpoint_update_mode != "separable")){
+		LOG_WARN("Checkpoint has unknown update mode '%'", checkpoint_update_mode);
+		return false;
+	}
+
+	// Values are copied out of 'checkpoint', which may be a memory map, into the working frames
+	auto read_section = [&](CheckpointSection section, auto& values, size_t n_values){
+		values.resize(n_values);
+		std::memcpy(values.data(), checkpoint.data() + checkpoint_section_offset(header, section), n_values*sizeof(values[0]));
+	};
+
+	update_mode = checkpoint_update_mode;
+	n_positive_iter = header.n_positive_iter;
+	loop_gain = header.loop_gain;
+	threshold = header.threshold;
+	rms_frac_threshold = header.rms_frac_threshold;
+	fabs_frac_threshold = header.fabs_frac_threshold;
+	fft_tile_size = header.fft_tile_size;
+	separable_psf_error = header.separable_psf_error;
+	psf_support_threshold = header.psf_support_threshold;
+	psf_symmetry_tolerance = header.psf_symmetry_tolerance;
+	clark_psf_patch_threshold = header.clark_psf_patch_threshold;
+	clark_max_minor_iter = header.clark_max_minor_iter;
+	clark_stop_on_rms_increase = header.clark_stop_on_rms_increase;
+	direct_update_max_pixels = header.direct_update_max_pixels;
+
+	data_shape = {header.data_shape[0], header.data_shape[1]};
+	data_shape_adjustment = {static_cast<int>(header.data_shape_adjustment[0]), static_cast<int>(header.data_shape_adjustment[1])};
+	data_size = du::product(data_shape);
+	input_psf_shape = {header.psf_shape[0], header.psf_shape[1]};
+	n_iter_done = header.n_iter_done;
+	stopping_criteria_met = header.stopping_criteria_met;
+	LOGV_DEBUG(data_shape, input_psf_shape, n_iter_done, stopping_criteria_met);
+
+	_prepare_frames();
+	read_section(CheckpointSection::RESIDUAL, residual_data, data_size);
+	read_section(CheckpointSection::COMPONENTS, components_data, data_size);
+	read_section(CheckpointSection::PSF, input_psf_data, du::product(input_psf_shape));
+	residual_peaks.set_shape(data_shape);
+	residual_peaks.refresh(residual_data);
+
+	// Records are 'n_iter' long, a checkpoint can hold more iterations than 'n_iter' allows
+	const size_t n_records = std::max<size_t>(n_iter, n_iter_done);
+	for(std::vector<double>* record : {&fabs_record, &rms_record, &threshold_record}){
+		record->assign(n_records, NAN);
+	}
+	for(auto [section, record] : {
+			std::pair{CheckpointSection::FABS_RECORD, &fabs_record}, 
+			std::pair{CheckpointSection::RMS_RECORD, &rms_record}, 
+			std::pair{CheckpointSection::THRESHOLD_RECORD, &threshold_record}
+		}){
+		std::memcpy(record->data(), checkpoint.data() + checkpoint_section_offset(header, section), n_iter_done*sizeof(double));
+	}
+
+	// "hybrid" mode's crossover comes from the checkpoint, so the updates are chosen as they
+	// were before it was saved
+	_prepare_psf_state(false);
+	return true;
+}
+
+template class CleanModifiedAlgorithm<double>;
+template class CleanModifiedAlgorithm<float>;
+
 
+template<class T>
+void HogbomCleanAlgorithm<T>::prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag
+	){
+	// Every update is one stamp
+	this->update_mode = "direct";
+	CleanModifiedAlgorithm<T>::prepare_observations(obs_data, obs_shape, psf_data, psf_shape, run_tag);
+	psf_peak = du::absmax(this->psf_stamp);
+}
+
+template<class T>
+bool HogbomCleanAlgorithm<T>::resume_from_checkpoint(std::span<const std::byte> checkpoint){
+	if (!CleanModifiedAlgorithm<T>::resume_from_checkpoint(checkpoint)){
+		return false;
+	}
+	psf_peak = du::absmax(this->psf_stamp);
+	return true;
+}
+
+template<class T>
+std::string HogbomCleanAlgorithm<T>::type_name() const {
+	return "hogbom";
+}
+
+template<class T>
+bool HogbomCleanAlgorithm<T>::doIter(size_t i){
+	GET_LOGGER;
+	LOGV_DEBUG(i);
+	update_deconv_stats(i, -1);
+
+	// Last iteration selected at most one pixel
+	set_box_to_zero(this->selected_pixels, this->data_shape, this->selected_box_offset, this->selected_box_shape);
+
+	const size_t nx = this->data_shape[0];
+	const size_t idx = this->residual_peaks.argmax(this->residual_data);
+	const T peak = this->residual_data[idx];
+	// The peak is the only pixel selected, record it as the threshold
+	this->px_threshold = std::abs(peak);
+	this->selected_pixels[idx] = this->loop_gain*peak/psf_peak;
+	this->n_selected_pixels = (peak != 0) ? 1 : 0;
+	this->selected_box_offset = {idx % nx, idx / nx};
+	this->selected_box_shape = {this->n_selected_pixels, this->n_selected_pixels};
+
+	this->_convolve_components();
+	return this->_apply_update(i);
+}
+
+template class HogbomCleanAlgorithm<double>;
+template class HogbomCleanAlgorithm<float>;
+
+
+template<class T>
+void ClarkCleanAlgorithm<T>::prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag
+	){
+	GET_LOGGER;
+	// Major cycles are full-frame FFT convolutions
+	this->update_mode = "fft";
+	CleanModifiedAlgorithm<T>::prepare_observations(obs_data, obs_shape, psf_data, psf_shape, run_tag);
+
+	this->_crop_psf(*this->padded_psf_data, this->clark_psf_patch_threshold, psf_patch, psf_patch_shape, psf_patch_offset);
+	psf_peak = du::absmax(psf_patch);
+	LOGV_DEBUG(psf_patch_shape, psf_patch_offset);
+}
+
+template<class T>
+bool ClarkCleanAlgorithm<T>::resume_from_checkpoint(std::span<const std::byte> checkpoint){
+	if (!CleanModifiedAlgorithm<T>::resume_from_checkpoint(checkpoint)){
+		return false;
+	}
+	this->_crop_psf(*this->padded_psf_data, this->clark_psf_patch_threshold, psf_patch, psf_patch_shape, psf_patch_offset);
+	psf_peak = du::absmax(psf_patch);
+	return true;
+}
+
+template<class T>
+std::string ClarkCleanAlgorithm<T>::type_name() const {
+	return "clark";
+}
+
+template<class T>
+bool ClarkCleanAlgorithm<T>::doIter(size_t i){
+	GET_LOGGER;
+	LOGV_DEBUG(i);
+	update_deconv_stats(i, -1);
+
+	// The minor cycle stops when its peak could be a sidelobe outside the patch of the
+	// brightest pixel, or is no longer above the usual pixel threshold
+	this->_calc_pixel_threshold();
+	const T peak = std::abs(this->residual_peaks.absmax());
+	const T cycle_threshold = std::max<T>(this->px_threshold, this->clark_psf_patch_threshold*peak);
+	this->px_threshold = cycle_threshold;
+
+	std::fill(this->selected_pixels.begin(), this->selected_pixels.end(), T(0));
+	minor_residual = this->residual_data;
+	minor_peaks = this->residual_peaks;
+	_minor_cycle(cycle_threshold);
+	if (this->n_selected_pixels == 0){
+		// Later major cycles would start from the same residual and find nothing either
+		this->_record_progress(i);
+		LOG_INFO("Deconvolution finished at % iterations. The minor cycle found no peak above %.", i+1, cycle_threshold);
+		return false;
+	}
+
+	// Major cycle, 'selected_pixels' holds this cycle's components
+	this->_fft_convolve(this->selected_pixels, this->current_convolved);
+	this->convolved_box_offset = {0, 0};
+	this->convolved_box_shape = this->data_shape;
+	bool iter_continue = this->_apply_update(i);
+
+	// See 'clark_stop_on_rms_increase'
+	if (this->clark_stop_on_rms_increase && iter_continue && (i > 0) && (this->rms_record[i] > this->rms_record[i-1])){
+		iter_continue = false;
+		LOG_INFO("Deconvolution finished at % iterations. Root mean square of residual % increased over the last major cycle.", i+1, this->rms_record[i]);
+	}
+	return iter_continue;
+}
+
+template<class T>
+void ClarkCleanAlgorithm<T>::_minor_cycle(T cycle_threshold){
+	GET_LOGGER;
+	const size_t nx = this->data_shape[0], ny = this->data_shape[1];
+	const T gain = this->loop_gain/psf_peak;
+
+	size_t n_minor_iter = 0;
+	for(; n_minor_iter<this->clark_max_minor_iter; ++n_minor_iter){
+		if (!(std::abs(minor_peaks.absmax()) > cycle_threshold)){
+			break;
+		}
+		const size_t idx = minor_peaks.argmax(minor_residual);
+		const size_t x0 = idx % nx, y0 = idx / nx;
+		const T component = gain*minor_residual[idx];
+		this->selected_pixels[idx] += component;
+
+		add_stamp<T>(minor_residual, this->data_shape, psf_patch, psf_patch_shape, psf_patch_offset, x0, y0, T(-component));
+		const std::vector<size_t> patch_box_offset{(x0 + nx - psf_patch_offset[0]) % nx, (y0 + ny - psf_patch_offset[1]) % ny};
+		for(size_t k : minor_peaks.tiles_overlapping(patch_box_offset, psf_patch_shape)){
+			minor_peaks.refresh_tile(k, minor_residual);
+		}
+		minor_peaks.update_levels();
+	}
+	this->n_selected_pixels = n_minor_iter;
+	LOGV_DEBUG(n_minor_iter);
+}
+
+template class ClarkCleanAlgorithm<double>;
+template class ClarkCleanAlgorithm<float>;
+
+
+template<class T>
+bool MultiScaleCleanAlgorithm<T>::supports_checkpoints() const {
+	return false;
+}
+
+template<class T>
+void MultiScaleCleanAlgorithm<T>::prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag
+	){
+	GET_LOGGER;
+	if (this->multiscale_sigmas.empty()){
+		LOG_WARN("No scales given for multi-scale CLEAN, using a point scale only.");
+		this->multiscale_sigmas = {0};
+	}
+	// Scale residuals and cross-scale PSFs are made with full-frame transforms
+	this->update_mode = "fft";
+	CleanModifiedAlgorithm<T>::prepare_observations(obs_data, obs_shape, psf_data, psf_shape, run_tag);
+
+	const size_t n_scales = this->multiscale_sigmas.size();
+	const size_t nx = this->data_shape[0], ny = this->data_shape[1];
+	const size_t spectrum_nx = nx/2 + 1;
+	const size_t spectrum_size = this->fft.spectrum_size;
+	LOGV_DEBUG(this->multiscale_sigmas);
+
+	// Gaussian kernels are separable with analytic transfer functions, see 'restore_clean_maps()'
+	scale_transfer_x.resize(n_scales);
+	scale_transfer_y.resize(n_scales);
+	for(size_t s=0; s<n_scales; ++s){
+		set_gaussian_transfer_function(scale_transfer_x[s], scale_transfer_y[s], this->data_shape, this->multiscale_sigmas[s], 1.0);
+	}
+	// The first scale kernel is a point when its sigma is zero, 'point' has a transfer
+	// function of one
+	scale_transfer_x.push_back(std::vector<T>(spectrum_nx, T(1)));
+	scale_transfer_y.push_back(std::vector<T>(ny, T(1)));
+	const size_t point = n_scales;
+
+	_refresh_scale_residuals();
 	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
-	if(add_residual){
-		LOG_DEBUG("Adding residual to clean map");
-		du::add_inplace(clean_map, residual_data);
+
+	// Spectrum with the 1/data_size normalisation of 'ifft' folded in
+	std::vector<complex> psf_spectrum(spectrum_size);
+	if (this->psf_is_symmetric){
+		std::copy(this->psf_fft_real->begin(), this->psf_fft_real->end(), psf_spectrum.begin());
 	} else {
-		LOG_DEBUG("Residual NOT added to clean map");
+		std::copy(this->psf_fft->begin(), this->psf_fft->end(), psf_spectrum.begin());
 	}
 
+	std::vector<T> frame(this->data_size);
+	scale_psf_stamps.resize(n_scales);
+	scale_kernel_stamps.resize(n_scales);
+	scale_psf_stamp_shapes.resize(n_scales);
+	scale_psf_stamp_offsets.resize(n_scales);
+	std::vector<complex> delta_spectrum(spectrum_size, complex(T(1)/this->data_size));
+	for(size_t t=0; t<n_scales; ++t){
+		_filter_and_invert(psf_spectrum, t, point, frame);
+		this->_crop_psf(frame, this->multiscale_support_threshold, scale_psf_stamps[t], scale_psf_stamp_shapes[t], scale_psf_stamp_offsets[t]);
+
+		// Scale kernel over the rectangle of the stamp
+		_filter_and_invert(delta_spectrum, t, point, frame);
+		const std::vector<size_t>& shape = scale_psf_stamp_shapes[t];
+		const std::vector<size_t>& offset = scale_psf_stamp_offsets[t];
+		scale_kernel_stamps[t].resize(du::product(shape));
+		for(size_t j=0; j<shape[1]; ++j){
+			const size_t y = (j + ny - offset[1]) % ny;
+			for(size_t i=0; i<shape[0]; ++i){
+				scale_kernel_stamps[t][i + j*shape[0]] = frame[(i + nx - offset[0]) % nx + y*nx];
+			}
+		}
+	}
 
-	du::write_as_image(_sprintf("./plots/%clean_map.pgm",tag), clean_map, data_shape);
+	// Cross terms are symmetric in the two scales
+	cross_psf_stamps.resize(n_scales*n_scales);
+	cross_psf_stamp_shapes.resize(n_scales*n_scales);
+	cross_psf_stamp_offsets.resize(n_scales*n_scales);
+	scale_psf_peaks.resize(n_scales);
+	for(size_t t=0; t<n_scales; ++t){
+		for(size_t s=0; s<=t; ++s){
+			const size_t st = s + t*n_scales, ts = t + s*n_scales;
+			_filter_and_invert(psf_spectrum, s, t, frame);
+			this->_crop_psf(frame, this->multiscale_support_threshold, cross_psf_stamps[st], cross_psf_stamp_shapes[st], cross_psf_stamp_offsets[st]);
+			cross_psf_stamps[ts] = cross_psf_stamps[st];
+			cross_psf_stamp_shapes[ts] = cross_psf_stamp_shapes[st];
+			cross_psf_stamp_offsets[ts] = cross_psf_stamp_offsets[st];
+		}
+		scale_psf_peaks[t] = std::abs(du::absmax(cross_psf_stamps[t + t*n_scales]));
+		LOGV_DEBUG(t, scale_psf_stamp_shapes[t], cross_psf_stamp_shapes[t + t*n_scales], scale_psf_peaks[t]);
+	}
+
+	const double max_sigma = *std::max_element(this->multiscale_sigmas.begin(), this->multiscale_sigmas.end());
+	scale_weights.resize(n_scales);
+	for(size_t s=0; s<n_scales; ++s){
+		scale_weights[s] = (max_sigma > 0) ? 1 - this->multiscale_bias*this->multiscale_sigmas[s]/max_sigma : 1;
+	}
+	LOGV_DEBUG(scale_weights);
+	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
+}
+
+template<class T>
+void MultiScaleCleanAlgorithm<T>::_filter_and_invert(const std::vector<complex>& spectrum, size_t s, size_t t, std::vector<T>& frame){
+	const size_t spectrum_nx = this->data_shape[0]/2 + 1, ny = this->data_shape[1];
+	// complex to real transforms overwrite their input, so filter into a copy
+	std::vector<complex> filtered(spectrum.size());
+	for(size_t j=0; j<ny; ++j){
+		const T fy = scale_transfer_y[s][j]*scale_transfer_y[t][j];
+		for(size_t i=0; i<spectrum_nx; ++i){
+			filtered[i + j*spectrum_nx] = spectrum[i + j*spectrum_nx]*(fy*scale_transfer_x[s][i]*scale_transfer_x[t][i]);
+		}
+	}
+	this->ifft.execute(filtered, frame);
+}
+
+template<class T>
+void MultiScaleCleanAlgorithm<T>::_refresh_scale_residuals(){
+	const size_t n_scales = this->multiscale_sigmas.size();
+	const size_t point = n_scales;
+
+	// Spectrum with the 1/data_size normalisation of 'ifft' folded in
+	std::vector<complex> residual_fft(this->fft.spectrum_size);
+	this->fft.execute(this->residual_data, residual_fft);
+	du::multiply_inplace(residual_fft, T(1)/this->data_size);
+
+	scale_residuals.resize(n_scales);
+	scale_peaks.resize(n_scales);
+	for(size_t s=0; s<n_scales; ++s){
+		scale_residuals[s].resize(this->data_size);
+		_filter_and_invert(residual_fft, s, point, scale_residuals[s]);
+		scale_peaks[s].set_shape(this->data_shape);
+		scale_peaks[s].refresh(scale_residuals[s]);
+	}
+}
+
+template<class T>
+std::string MultiScaleCleanAlgorithm<T>::type_name() const {
+	return "multiscale";
+}
+
+template<class T>
+bool MultiScaleCleanAlgorithm<T>::doIter(size_t i){
+	GET_LOGGER;
+	LOGV_DEBUG(i);
+	update_deconv_stats(i, -1);
+
+	const std::vector<size_t>& frame_shape = this->data_shape;
+	const size_t n_scales = scale_residuals.size();
+	const size_t nx = frame_shape[0];
+
+	// Stamps leave out the PSF below 'multiscale_support_threshold', so the scale residuals
+	// drift from the residual convolved with the scale kernels
+	if ((this->multiscale_refresh_interval > 0) && (i > 0) && (i % this->multiscale_refresh_interval == 0)){
+		LOG_DEBUG("Refreshing scale residuals at iteration %", i);
+		_refresh_scale_residuals();
+	}
+
+	// Scale whose component would best fit the residual. A component of scale s at the peak
+	// of its residual reduces the residual's sum of squares by peak^2/scale_psf_peaks[s],
+	// scale residuals are smoothed by unit-sum kernels so peaks are compared through this.
+	size_t t = 0;
+	T best_fit = -1;
+	for(size_t s=0; s<n_scales; ++s){
+		const T fit = scale_weights[s]*std::abs(scale_peaks[s].absmax())/std::sqrt(scale_psf_peaks[s]);
+		if (fit > best_fit){
+			best_fit = fit;
+			t = s;
+		}
+	}
+	const size_t idx = scale_peaks[t].argmax(scale_residuals[t]);
+	const size_t x0 = idx % nx, y0 = idx / nx;
+	const T peak = scale_residuals[t][idx];
+	const T amplitude = this->loop_gain*peak/scale_psf_peaks[t];
+	LOGV_DEBUG(t, idx, peak);
+
+	// The component and its convolution with the PSF replace last iteration's, the
+	// residual and components are updated by '_apply_update()'
+	set_box_to_zero(this->selected_pixels, frame_shape, this->selected_box_offset, this->selected_box_shape);
+	set_box_to_zero(this->current_convolved, frame_shape, this->convolved_box_offset, this->convolved_box_shape);
+	add_stamp(this->selected_pixels, frame_shape, scale_kernel_stamps[t], scale_psf_stamp_shapes[t], scale_psf_stamp_offsets[t], x0, y0, amplitude);
+	add_stamp(this->current_convolved, frame_shape, scale_psf_stamps[t], scale_psf_stamp_shapes[t], scale_psf_stamp_offsets[t], x0, y0, amplitude);
+	for(size_t a=0; a<2; ++a){
+		this->selected_box_offset[a] = ((a == 0 ? x0 : y0) + frame_shape[a] - scale_psf_stamp_offsets[t][a]) % frame_shape[a];
+		this->selected_box_shape[a] = scale_psf_stamp_shapes[t][a];
+	}
+	this->convolved_box_offset = this->selected_box_offset;
+	this->convolved_box_shape = this->selected_box_shape;
+	this->n_selected_pixels = du::product(this->selected_box_shape);
+
+	// Every scale's residual loses the component convolved with the PSF and that scale's kernel
+	for(size_t s=0; s<n_scales; ++s){
+		const size_t st = s + t*n_scales;
+		add_stamp<T>(scale_residuals[s], frame_shape, cross_psf_stamps[st], cross_psf_stamp_shapes[st], cross_psf_stamp_offsets[st], x0, y0, T(-amplitude));
+		const std::vector<size_t> box_offset{
+			(x0 + frame_shape[0] - cross_psf_stamp_offsets[st][0]) % frame_shape[0],
+			(y0 + frame_shape[1] - cross_psf_stamp_offsets[st][1]) % frame_shape[1]
+		};
+		for(size_t k : scale_peaks[s].tiles_overlapping(box_offset, cross_psf_stamp_shapes[st])){
+			scale_peaks[s].refresh_tile(k, scale_residuals[s]);
+		}
+		scale_peaks[s].update_levels();
+	}
+
+	this->px_threshold = std::abs(peak);
+	return this->_apply_update(i);
+}
+
+template class MultiScaleCleanAlgorithm<double>;
+template class MultiScaleCleanAlgorithm<float>;
+
+
+template<class T>
+bool RichardsonLucyAlgorithm<T>::supports_checkpoints() const {
+	return false;
+}
+
+template<class T>
+void RichardsonLucyAlgorithm<T>::prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag
+	){
+	GET_LOGGER;
+	// Every iteration is two full-frame convolutions
+	this->update_mode = "fft";
+	CleanModifiedAlgorithm<T>::prepare_observations(obs_data, obs_shape, psf_data, psf_shape, run_tag);
+
+	const size_t n_px = this->data_size;
+	// The algorithm assumes a non-negative observation, negative (noise) pixels would make
+	// estimates negative and are treated as zero
+	observed_data = this->residual_data;
+	for(T& v : observed_data){
+		v = std::max(v, T(0));
+	}
+	previous_estimate.resize(n_px);
+	prediction.resize(n_px);
+	predicted_obs.resize(n_px);
+	ratio.resize(n_px);
+	correction.resize(n_px);
+	step.assign(n_px, T(0));
+	acceleration = 0;
+	this->px_threshold = 0;
+	this->_prepare_psf_adjoint();
+
+	// Flat first estimate with the observation's flux
+	const double flux = du::sum<T,double>(observed_data);
+	du::set_to(this->components_data, static_cast<T>(flux/n_px));
+	previous_estimate = this->components_data;
+	LOGV_DEBUG(flux, this->psf_is_symmetric);
+}
+
+template<class T>
+std::string RichardsonLucyAlgorithm<T>::type_name() const {
+	return "richardson_lucy";
+}
+
+template<class T>
+bool RichardsonLucyAlgorithm<T>::doIter(size_t i){
+	GET_LOGGER;
+	LOGV_DEBUG(i, acceleration);
+	update_deconv_stats(i, -1);
+
+	std::vector<T>& estimate = this->components_data;
+	const size_t n_px = this->data_size;
+
+	// Extrapolate along the last step, the estimate must stay non-negative
+	for(size_t idx=0; idx<n_px; ++idx){
+		prediction[idx] = std::max(estimate[idx] + acceleration*(estimate[idx] - previous_estimate[idx]), T(0));
+	}
+
+	// The residual of the prediction is found on the way to the ratio
+	this->_fft_convolve(prediction, predicted_obs);
+	for(size_t idx=0; idx<n_px; ++idx){
+		const T p = predicted_obs[idx];
+		this->residual_data[idx] = observed_data[idx] - p;
+		ratio[idx] = (p > 0) ? observed_data[idx]/p : T(0);
+	}
+	this->residual_peaks.refresh(this->residual_data);
+
+	// Multiplicative update, and the products of this step with the last for the next
+	// extrapolation
+	this->_fft_convolve_adjoint(ratio, correction);
+	double step_product = 0;
+	double step_norm = 0;
+	for(size_t idx=0; idx<n_px; ++idx){
+		const T updated = std::max(prediction[idx]*correction[idx], T(0));
+		const T new_step = updated - prediction[idx];
+		step_product += new_step*step[idx];
+		step_norm += step[idx]*step[idx];
+		step[idx] = new_step;
+		previous_estimate[idx] = estimate[idx];
+		estimate[idx] = updated;
+	}
+	acceleration = 0;
+	if (this->richardson_lucy_acceleration && (step_norm > 0)){
+		acceleration = static_cast<T>(std::clamp(step_product/step_norm, 0.0, 1.0));
+	}
+
+	bool iter_continue = this->_record_progress(i);
+	if (!iter_continue){
+		// Residual of the final estimate rather than of the last prediction
+		this->_fft_convolve(estimate, predicted_obs);
+		for(size_t idx=0; idx<n_px; ++idx){
+			this->residual_data[idx] = observed_data[idx] - predicted_obs[idx];
+		}
+		this->residual_peaks.refresh(this->residual_data);
+	}
+	return iter_continue;
+}
+
+template class RichardsonLucyAlgorithm<double>;
+template class RichardsonLucyAlgorithm<float>;
+
+
+template<class T>
+bool FistaAlgorithm<T>::supports_checkpoints() const {
+	return false;
+}
+
+template<class T>
+void FistaAlgorithm<T>::prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag
+	){
+	GET_LOGGER;
+	// Every iteration is two full-frame convolutions
+	this->update_mode = "fft";
+	CleanModifiedAlgorithm<T>::prepare_observations(obs_data, obs_shape, psf_data, psf_shape, run_tag);
+	this->_prepare_psf_adjoint();
+
+	const size_t n_px = this->data_size;
+	observed_data = this->residual_data;
+	previous_estimate.assign(n_px, T(0));
+	momentum_point.assign(n_px, T(0));
+	predicted_obs.resize(n_px);
+	gradient.resize(n_px);
+	momentum_t = 1;
+	this->px_threshold = 0;
+
+	// Convolving with the PSF then its adjoint multiplies the spectrum by |psf spectrum|^2,
+	// 'psf_fft' has the 1/data_size normalisation folded in.
+	double max_power = 0;
+	if (this->psf_is_symmetric){
+		for(const T v : *this->psf_fft_real){
+			max_power = std::max(max_power, static_cast<double>(v*v));
+		}
+	} else {
+		for(const auto& c : *this->psf_fft){
+			max_power = std::max(max_power, static_cast<double>(std::norm(c)));
+		}
+	}
+	max_power *= static_cast<double>(n_px)*n_px;
+	step_size = (max_power > 0) ? static_cast<T>(1.0/max_power) : T(0);
+
+	// Below a weight of max|adjoint(observation)| the all zero estimate is not optimal
+	this->_fft_convolve_adjoint(observed_data, gradient);
+	const double zero_solution_weight = std::abs(du::absmax(gradient));
+	l1_threshold = static_cast<T>(this->fista_l1_weight*zero_solution_weight*step_size);
+	LOGV_DEBUG(max_power, zero_solution_weight, step_size, l1_threshold);
+}
+
+template<class T>
+std::string FistaAlgorithm<T>::type_name() const {
+	return "fista";
+}
+
+template<class T>
+bool FistaAlgorithm<T>::doIter(size_t i){
+	GET_LOGGER;
+	LOGV_DEBUG(i, momentum_t);
+	update_deconv_stats(i, -1);
+
+	std::vector<T>& estimate = this->components_data;
+	const size_t n_px = this->data_size;
+
+	// Residual at the momentum point, and the negative gradient there
+	this->_fft_convolve(momentum_point, predicted_obs);
+	for(size_t idx=0; idx<n_px; ++idx){
+		this->residual_data[idx] = observed_data[idx] - predicted_obs[idx];
+	}
+	this->residual_peaks.refresh(this->residual_data);
+	this->_fft_convolve_adjoint(this->residual_data, gradient);
+
+	// Gradient step then the proximal step, soft thresholding for the L1 norm and clipping
+	// for non-negativity. Without clipping the lower bound is never reached.
+	const T lower = this->fista_positive ? T(0) : std::numeric_limits<T>::lowest();
+	const T tau = l1_threshold;
+	double restart_product = 0;
+	for(size_t idx=0; idx<n_px; ++idx){
+		const T v = momentum_point[idx] + step_size*gradient[idx];
+		const T updated = std::max(v - std::clamp(v, -tau, tau), lower);
+		restart_product += (momentum_point[idx] - updated)*(updated - estimate[idx]);
+		previous_estimate[idx] = estimate[idx];
+		estimate[idx] = updated;
+	}
+
+	// Restart the momentum when it points against the step just taken
+	if (restart_product > 0){
+		LOG_DEBUG("Restarting momentum at iteration %", i);
+		momentum_t = 1;
+	}
+	const double next_t = (1 + std::sqrt(1 + 4*momentum_t*momentum_t))/2;
+	const T beta = static_cast<T>((momentum_t - 1)/next_t);
+	momentum_t = next_t;
+	for(size_t idx=0; idx<n_px; ++idx){
+		momentum_point[idx] = estimate[idx] + beta*(estimate[idx] - previous_estimate[idx]);
+	}
+
+	bool iter_continue = this->_record_progress(i);
+	if (!iter_continue){
+		// Residual of the final estimate rather than of the last momentum point
+		this->_fft_convolve(estimate, predicted_obs);
+		for(size_t idx=0; idx<n_px; ++idx){
+			this->residual_data[idx] = observed_data[idx] - predicted_obs[idx];
+		}
+		this->residual_peaks.refresh(this->residual_data);
+	}
+	return iter_continue;
+}
+
+template class FistaAlgorithm<double>;
+template class FistaAlgorithm<float>;
+
+
+template<class T>
+std::string BatchedCleanModifiedAlgorithm<T>::precision() const {
+	return FFTPrecision<T>::name;
+}
+
+template<class T>
+std::string BatchedCleanModifiedAlgorithm<T>::type_name() const {
+	return "clean_modified";
+}
+
+template<class T>
+bool BatchedCleanModifiedAlgorithm<T>::handles_all_channels() const {
+	return true;
+}
+
+template<class T>
+std::vector<double> BatchedCleanModifiedAlgorithm<T>::get_clean_map() const {
+	std::vector<double> result;
+	result.reserve(n_channels*data_size);
+	for(const CleanModifiedAlgorithm<T>& channel : channels){
+		const std::vector<double> channel_result = channel.get_clean_map();
+		result.insert(result.end(), channel_result.begin(), channel_result.end());
+	}
+	return result;
+}
+
+template<class T>
+std::vector<double> BatchedCleanModifiedAlgorithm<T>::get_residual() const {
+	std::vector<double> result;
+	result.reserve(n_channels*data_size);
+	for(const CleanModifiedAlgorithm<T>& channel : channels){
+		const std::vector<double> channel_result = channel.get_residual();
+		result.insert(result.end(), channel_result.begin(), channel_result.end());
+	}
+	return result;
+}
+
+template<class T>
+size_t BatchedCleanModifiedAlgorithm<T>::n_extra_clean_maps() const {
+	return channels.empty() ? 0 : channels[0].n_extra_clean_maps();
+}
+
+template<class T>
+std::vector<double> BatchedCleanModifiedAlgorithm<T>::get_extra_clean_map(size_t k) const {
+	std::vector<double> result;
+	result.reserve(n_channels*data_size);
+	for(const CleanModifiedAlgorithm<T>& channel : channels){
+		const std::vector<double> channel_result = channel.get_extra_clean_map(k);
+		result.insert(result.end(), channel_result.begin(), channel_result.end());
+	}
+	return result;
+}
+
+template<class T>
+void BatchedCleanModifiedAlgorithm<T>::prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag
+	){
+	GET_LOGGER;
+	assert((obs_shape.size() == 3) && (psf_shape.size() == 3));
+	tag = run_tag;
+	n_iter_done = 0;
+	stopping_criteria_met = false;
+	n_channels = obs_shape[2];
+	const bool multi_channel_psf = psf_shape[2] > 1;
+	const size_t obs_layer_size = obs_shape[0]*obs_shape[1];
+	const size_t psf_layer_size = psf_shape[0]*psf_shape[1];
+	LOGV_DEBUG(n_channels, multi_channel_psf);
+
+	channels.resize(n_channels);
+	channel_continue.assign(n_channels, true);
+	for(size_t c=0; c<n_channels; ++c){
+		LOG_DEBUG("Preparing channel %", c);
+		CleanModifiedAlgorithm<T>& channel = channels[c];
+		// Channels share this object's parameters, only the first plots its progress
+		static_cast<CleanModifiedAlgorithmBase&>(channel) = *this;
+		if (c > 0){
+			channel.plot_update_interval = 0;
+		}
+		channel.prepare_observations(
+			obs_data.subspan(c*obs_layer_size, obs_layer_size),
+			obs_shape.first(2),
+			psf_data.subspan((multi_channel_psf ? c : 0)*psf_layer_size, psf_layer_size),
+			psf_shape.first(2),
+			run_tag
+		);
+	}
+
+	data_shape = channels[0].data_shape;
+	data_size = channels[0].data_size;
+	data_shape_adjustment = channels[0].data_shape_adjustment;
+
+	if (!_uses_psf_spectrum()){
+		// channels convolve in tiles or with separable passes, there is nothing to batch
+		return;
+	}
+
+	LOG_DEBUG("set batched FFT attributes");
+	fft.set_attrs(data_shape, false, fft_plan_rigor, true, n_fft_threads, n_channels);
+	ifft.set_attrs(data_shape, true, fft_plan_rigor, true, n_fft_threads, n_channels);
+	batch_pixels.assign(n_channels*data_size, T(0));
+	batch_px_fft.resize(n_channels*fft.spectrum_size);
+	batch_convolved.assign(n_channels*data_size, T(0));
+	// Each channel selects into, and updates from, its frames in the batch buffers so
+	// nothing is copied between them each iteration
+	for(size_t c=0; c<n_channels; ++c){
+		channels[c].selected_pixels = std::span<T>(batch_pixels).subspan(c*data_size, data_size);
+		channels[c].current_convolved = std::span<T>(batch_convolved).subspan(c*data_size, data_size);
+		channels[c].owned_selected_pixels = std::vector<T>();
+		channels[c].owned_current_convolved = std::vector<T>();
+	}
+
+	// When channels share a PSF one spectrum is used for the whole batch, see 'FourierTransformer::convolve()'
+	const bool all_symmetric = std::all_of(channels.begin(), channels.end(), [](const auto& channel){return channel.psf_is_symmetric;});
+	if (!multi_channel_psf){
+		batch_psf_fft = channels[0].psf_fft;
+		batch_psf_fft_real = channels[0].psf_fft_real;
+		return;
+	}
+	if (all_symmetric){
+		std::vector<T> psf_spectra(n_channels*fft.spectrum_size);
+		for(size_t c=0; c<n_channels; ++c){
+			std::copy(channels[c].psf_fft_real->begin(), channels[c].psf_fft_real->end(), psf_spectra.begin() + c*fft.spectrum_size);
+		}
+		batch_psf_fft = nullptr;
+		batch_psf_fft_real = std::make_shared<const std::vector<T>>(std::move(psf_spectra));
+		return;
+	}
+	// Symmetric channels only have the real part of their spectrum
+	std::vector<complex> psf_spectra(n_channels*fft.spectrum_size);
+	for(size_t c=0; c<n_channels; ++c){
+		if (channels[c].psf_is_symmetric){
+			std::copy(channels[c].psf_fft_real->begin(), channels[c].psf_fft_real->end(), psf_spectra.begin() + c*fft.spectrum_size);
+		} else {
+			std::copy(channels[c].psf_fft->begin(), channels[c].psf_fft->end(), psf_spectra.begin() + c*fft.spectrum_size);
+		}
+	}
+	batch_psf_fft = std::make_shared<const std::vector<complex>>(std::move(psf_spectra));
+	batch_psf_fft_real = nullptr;
+}
+
+template<class T>
+bool BatchedCleanModifiedAlgorithm<T>::doIter(size_t i){
+	GET_LOGGER;
+	LOGV_DEBUG(i);
+	update_deconv_stats(i, -1);
+
+	std::vector<bool> batched(n_channels, false);
+	bool any_batched = false;
+	for(size_t c=0; c<n_channels; ++c){
+		if (!channel_continue[c]){
+			continue;
+		}
+		channels[c]._select_components();
+		batched[c] = channels[c]._use_fft_update();
+		any_batched = any_batched || batched[c];
+	}
+
+	if (any_batched){
+		// Every channel's selection is already in 'batch_pixels'. Those not in the batch are
+		// transformed too, and convolve their own frame again below.
+		fft.execute(batch_pixels, batch_px_fft);
+		if (batch_psf_fft_real){
+			ifft.convolve(batch_px_fft, *batch_psf_fft_real, batch_convolved);
+		} else {
+			ifft.convolve(batch_px_fft, *batch_psf_fft, batch_convolved);
+		}
+	}
+
+	bool iter_continue = false;
+	for(size_t c=0; c<n_channels; ++c){
+		if (!channel_continue[c]){
+			continue;
+		}
+		if (batched[c]){
+			channels[c].convolved_box_offset = {0, 0};
+			channels[c].convolved_box_shape = data_shape;
+		} else {
+			if (any_batched){
+				// The batch overwrote all of this channel's 'current_convolved'
+				channels[c].convolved_box_offset = {0, 0};
+				channels[c].convolved_box_shape = data_shape;
+			}
+			channels[c]._convolve_components();
+		}
+		channel_continue[c] = channels[c]._apply_update(i);
+		iter_continue = iter_continue || channel_continue[c];
+	}
+	return iter_continue;
+}
+
+template<class T>
+void BatchedCleanModifiedAlgorithm<T>::run(){
+	GET_LOGGER;
+	LOG_DEBUG("Starting batched deconvolution of % channels n_iter %", n_channels, n_iter);
+
+	timer::start();
+	running = true;
+	paused = false;
+	for(size_t i=n_iter_done; i<n_iter && !stopping_criteria_met && !paused; ++i){
+		stopping_criteria_met = !doIter(i);
+		n_iter_done = i+1;
+	}
+	running = false;
+	// A pause asked for during the last iteration does not stop anything
+	paused = paused && (n_iter_done < n_iter) && !stopping_criteria_met;
+	if (paused){
+		LOG_INFO("Paused after % iterations", n_iter_done);
+	}
+
+	for(CleanModifiedAlgorithm<T>& channel : channels){
+		channel._make_clean_map();
+	}
 
 	timer::stop();
 	LOGV_DEBUG(timer::n_seconds());
 }
 
 
+template<class T>
+void BatchedCleanModifiedAlgorithm<T>::prepare_preview(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag
+	){
+	assert((obs_shape.size() == 3) && (psf_shape.size() == 3));
+	tag = run_tag;
+	n_iter_done = 0;
+	stopping_criteria_met = false;
+	n_channels = obs_shape[2];
+	const bool multi_channel_psf = psf_shape[2] > 1;
+	const size_t obs_layer_size = obs_shape[0]*obs_shape[1];
+	const size_t psf_layer_size = psf_shape[0]*psf_shape[1];
+
+	channels.resize(n_channels);
+	for(size_t c=0; c<n_channels; ++c){
+		CleanModifiedAlgorithm<T>& channel = channels[c];
+		static_cast<CleanModifiedAlgorithmBase&>(channel) = *this;
+		channel.prepare_preview(
+			obs_data.subspan(c*obs_layer_size, obs_layer_size),
+			obs_shape.first(2),
+			psf_data.subspan((multi_channel_psf ? c : 0)*psf_layer_size, psf_layer_size),
+			psf_shape.first(2),
+			run_tag
+		);
+	}
+
+	data_shape = channels[0].data_shape;
+	data_size = channels[0].data_size;
+	data_shape_adjustment = channels[0].data_shape_adjustment;
+}
 
+template<class T>
+void BatchedCleanModifiedAlgorithm<T>::preview(){
+	GET_LOGGER;
+	// Channels do not count the iterations of a batched run, this object does
+	if (n_iter_done > 0){
+		LOG_ERROR("Cannot preview after % iterations have been run, the clean maps are unchanged. Prepare the observations again first.", n_iter_done);
+		return;
+	}
+	for(CleanModifiedAlgorithm<T>& channel : channels){
+		channel.preview();
+	}
+}
 
 
+template class BatchedCleanModifiedAlgorithm<double>;
+template class BatchedCleanModifiedAlgorithm<float>;
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <string_view>
 #include <span>
+#include <limits>
 
 //#include <iostream>
 #include "Eigen/Dense"
@@ -29,6 +30,10 @@
 //#include "emscripten/bind.h"
 #include "emscripten/val.h"
 #include "fft.hpp"
+#include "tiled_convolver.hpp"
+#include "separable_convolver.hpp"
+#include "tile_max_pyramid.hpp"
+#include "psf_cache.hpp"
 #include "storage.hpp"
 #include "js_glue.hpp"
 //#include "tiff_helper.hpp"
@@ -49,7 +54,154 @@ struct ParameterInformation{
 };
 
 
-class CleanModifiedAlgorithm {
+// Start of a checkpoint of a deconvolver's state, see 'Deconvolver::save_checkpoint()'. The
+// frames and records follow in the order of 'CheckpointSection', each starting at a multiple of
+// 8 bytes from the header so they can be read in place from a memory map of the file.
+// Values are in the byte order and precision of the machine that wrote them.
+struct CheckpointHeader{
+	static constexpr char expected_magic[8] = {'D','E','C','O','N','V','C','K'};
+	static constexpr uint32_t current_version = 2;
+	static constexpr uint32_t byte_order_mark = 0x01020304;
+
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t value_size; // bytes per value of the frames, 8 for double, 4 for float
+	uint32_t stopping_criteria_met;
+	char deconvolver_type[16]; // 'Deconvolver::type_name()', zero padded
+	uint64_t data_shape[2];
+	int64_t data_shape_adjustment[2];
+	uint64_t psf_shape[2];
+	uint64_t n_iter_done;
+
+	// Parameters the iterations depend on, restored on resume so the run continues as it
+	// started. Those only used to make the clean map at the end, such as the clean beams,
+	// and 'n_iter' are the resuming deconvolver's own.
+	char update_mode[16]; // zero padded
+	uint64_t n_positive_iter;
+	double loop_gain;
+	double threshold;
+	double rms_frac_threshold;
+	double fabs_frac_threshold;
+	uint64_t fft_tile_size;
+	double separable_psf_error;
+	double psf_support_threshold;
+	double psf_symmetry_tolerance;
+	double clark_psf_patch_threshold;
+	uint64_t clark_max_minor_iter;
+	uint64_t clark_stop_on_rms_increase;
+	// Calibrated by "hybrid" mode, which depends on timings of the machine that saved it
+	uint64_t direct_update_max_pixels;
+};
+
+// Sections of a checkpoint after its header: the residual, the components, the PSF as it was
+// given to 'prepare_observations()', then 'n_iter_done' values of each record
+enum class CheckpointSection {RESIDUAL, COMPONENTS, PSF, FABS_RECORD, RMS_RECORD, THRESHOLD_RECORD, END};
+
+// Byte offset of 'section' from the start of a checkpoint with 'header'
+size_t checkpoint_section_offset(const CheckpointHeader& header, CheckpointSection section);
+
+// True when the sections of a checkpoint with 'header' fit in 'n_bytes'. Every product and
+// sum is checked against 'n_bytes' before it is made, so untrusted headers cannot overflow
+// them. Once this is true 'checkpoint_section_offset()' cannot overflow either.
+bool checkpoint_fits(const CheckpointHeader& header, size_t n_bytes);
+
+
+// Interface shared by all deconvolution algorithms so they can be created, prepared,
+// and run the same way from 'main.cpp'. Inputs and results are double, as 'Image'
+// data is, algorithms can compute in a different precision internally.
+class Deconvolver {
+	public:
+
+	// Input data parameters
+	size_t data_size;
+	std::vector<size_t> data_shape;
+	// 'data_shape' minus the shape of the observation, i.e., the padding added to make
+	// transforms fast, results should be cropped back to the observation's shape.
+	std::vector<int> data_shape_adjustment;
+	// Number of colour channels the results hold, one after another (RRR...GGG...)
+	size_t n_channels;
+	std::string tag;
+
+	// FFT control parameters
+	PlanRigor fft_plan_rigor;
+	size_t n_fft_threads; // zero for one per core, see 'fft_n_threads()'
+
+	// Plot control parameters
+	size_t plot_update_interval;
+
+	// True while 'run()' is iterating. It yields to the event loop part way through
+	// iterations, when the state is between two of them.
+	bool running;
+	// Set by 'pause()', true when the last 'run()' returned before it finished
+	bool paused;
+
+	Deconvolver();
+	virtual ~Deconvolver() = default;
+
+	// "double" or "float", the precision the algorithm computes in
+	virtual std::string precision() const = 0;
+	// Name of the algorithm, as 'main.cpp' creates it by
+	virtual std::string type_name() const = 0;
+
+	// When true 'prepare_observations()' takes every channel of an image at once, the
+	// last axis of 'obs_shape' and 'psf_shape' being the channel axis. Otherwise it
+	// takes one channel at a time.
+	virtual bool handles_all_channels() const;
+
+	virtual void prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	) = 0;
+
+	virtual void run() = 0;
+	// Asks a 'run()' in progress to return once the current iteration is done. Calling
+	// 'run()' again continues from there. Does nothing when no run is in progress.
+	void pause();
+
+	// Prepares only what 'preview()' needs, which for most algorithms is much less than
+	// 'prepare_observations()' does. 'run()' still needs 'prepare_observations()'.
+	virtual void prepare_preview(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	);
+
+	// Makes a quick, non-iterative estimate of the clean map from the prepared observations
+	// instead of calling 'run()', so the PSF and parameters can be judged first. The
+	// residual is left as the observation. Once 'run()' has done any iterations there is
+	// nothing to preview, the clean map is left unchanged and an error logged.
+	virtual void preview();
+
+	// Checkpoints hold the state of a run so it can continue later, or on another machine,
+	// without preparing the observations again, see 'CheckpointHeader'. Only algorithms for
+	// which this returns true can save or resume from them.
+	virtual bool supports_checkpoints() const;
+	// Bytes of a checkpoint of the current state. Empty when checkpoints are not supported,
+	// or while 'running', pause the run first.
+	virtual std::vector<std::byte> save_checkpoint() const;
+	// Replaces 'prepare_observations()' with the state in 'checkpoint', 'run()' then continues
+	// from the iteration after the last one the checkpoint holds. Returns false, leaving the
+	// deconvolver unprepared, when 'checkpoint' cannot be used: it is damaged, or was saved
+	// by another type of algorithm or precision.
+	virtual bool resume_from_checkpoint(std::span<const std::byte> checkpoint);
+
+	// Results have 'data_shape' for each of 'n_channels'
+	virtual std::vector<double> get_clean_map() const = 0;
+	virtual std::vector<double> get_residual() const = 0;
+	// Clean maps restored with each of the extra clean beams, empty when an algorithm has none
+	virtual size_t n_extra_clean_maps() const;
+	virtual std::vector<double> get_extra_clean_map(size_t k) const;
+};
+
+
+// Parameters and state of 'CleanModifiedAlgorithm' that do not depend on its precision
+class CleanModifiedAlgorithmBase : public Deconvolver {
 	public:
 
 	// Where to store results
@@ -61,55 +213,109 @@ class CleanModifiedAlgorithm {
 	size_t n_iter;
 	size_t n_positive_iter;
 	double loop_gain;
+	// Fraction of the brightest residual pixel above which pixels are selected. Zero or
+	// negative chooses the threshold each iteration with Otsu's method.
 	double threshold;
+	// Standard deviation (in pixels) of the unit-sum gaussian clean beam, zero for none. Before
+	// the beam was applied as a transfer function the kernel was exp(-r^2/sigma^2), of standard
+	// deviation sigma/sqrt(2), so old values give a beam sqrt(2) times wider.
 	double clean_beam_gaussian_sigma;
+	// Standard deviations (in pixels) of further clean beams, each gives an extra clean
+	// map restored from the same transform of the components as 'clean_map'.
+	std::vector<double> extra_clean_beam_sigmas;
 	bool add_residual;
 	double noise_std;
 	double rms_frac_threshold;
 	double fabs_frac_threshold;
-	
-	// Plot control parameters
-	size_t plot_update_interval;
-	
-	// Input data parameters
-	size_t data_size;
-	std::vector<size_t> data_shape;
-	std::vector<double> residual_data;
-	std::vector<double> components_data;
-	std::vector<double> clean_map;
-	std::vector<bool> px_choice_map;
+
+	// How the convolved selected pixels are found each iteration. One of
+	// "fft"    : full-frame FFT convolution,
+	// "direct" : add a PSF stamp at each selected pixel,
+	// "hybrid" : use whichever is cheaper for the number of selected pixels,
+	// "tiled"  : overlap-add FFT convolution in tiles of about 'fft_tile_size' pixels,
+	//            for frames too large for full-frame transforms.
+	// "separable" : row and column passes with a sum of separable terms approximating
+	//            the PSF stamp to within 'separable_psf_error', see 'SeparableConvolver'.
+	std::string update_mode;
+	size_t fft_tile_size;
+	// Largest Frobenius norm error, as a fraction of the PSF stamp's, of the separable
+	// approximation used in "separable" mode
+	double separable_psf_error;
+	// PSF pixels with absolute value at or below this fraction of the PSF's maximum are
+	// left out of the stamp used by direct updates. Zero keeps direct updates exact.
+	double psf_support_threshold;
+	// PSFs that differ from their point reflection through their centre by at most this
+	// fraction of their maximum are treated as centrosymmetric. Their spectrum is real, so
+	// full-frame FFT updates multiply by a real spectrum of half the size. The PSF's
+	// symmetric part is used, negative never treats PSFs as symmetric.
+	double psf_symmetry_tolerance;
+	// Clark CLEAN, see 'ClarkCleanAlgorithm'. PSF pixels above this fraction of the PSF's
+	// maximum form the patch subtracted in minor cycles. A minor cycle stops once its peak
+	// is at or below the larger of the pixel threshold and this fraction of the peak it
+	// started from.
+	double clark_psf_patch_threshold;
+	// Most peaks subtracted in one minor cycle. Iterations stop when a minor cycle finds none.
+	size_t clark_max_minor_iter;
+	// Stop when a major cycle increases the root mean square of the residual
+	bool clark_stop_on_rms_increase;
+	// Multi-scale CLEAN, see 'MultiScaleCleanAlgorithm'. Standard deviations (in pixels) of
+	// the unit-sum gaussian scale kernels, zero is a point.
+	std::vector<double> multiscale_sigmas;
+	// How well components of each scale fit is weighted by 1 - multiscale_bias*sigma/(largest sigma)
+	// when choosing the scale, so larger scales only win when they clearly fit better
+	double multiscale_bias;
+	// Pixels of the PSF convolved with scale kernels at or below this fraction of their
+	// maximum are left out of the stamps subtracted each iteration
+	double multiscale_support_threshold;
+	// The scale residuals are made again from the residual with one transform every this
+	// many iterations, undoing the drift from stamps cropped at 'multiscale_support_threshold'.
+	// Zero never remakes them.
+	size_t multiscale_refresh_interval;
+	// Richardson-Lucy, see 'RichardsonLucyAlgorithm'. Extrapolates each iteration's starting
+	// point along the last step (Biggs-Andrews acceleration).
+	bool richardson_lucy_acceleration;
+	// FISTA, see 'FistaAlgorithm'. Weight of the L1 norm of the estimate as a fraction of the
+	// smallest weight for which an all zero estimate is optimal, zero leaves the L1 norm out.
+	double fista_l1_weight;
+	// Constrains FISTA's estimate to be non-negative
+	bool fista_positive;
+	// Regularisation of the Wiener filter 'preview()' uses, as a fraction of the PSF's largest
+	// squared spectral magnitude. Larger values suppress more noise but deconvolve less.
+	double preview_regularisation;
 	
 	// Internal state
-	std::vector<int> data_shape_adjustment;
+	// Only filled by the experimental loop gain scaling in '_select_components()'
+	std::vector<bool> px_choice_map;
 	double px_threshold;
-	std::vector<double> padded_psf_data;
-	std::vector<double> selected_pixels;
-	std::vector<double> current_convolved;
+	size_t n_selected_pixels;
+	// Smallest rectangle holding the selected pixels, {x,y}. The shape is {0,0} when no
+	// pixels are selected.
+	std::vector<size_t> selected_box_offset;
+	std::vector<size_t> selected_box_shape;
+	std::vector<size_t> psf_stamp_shape;
+	std::vector<size_t> psf_stamp_offset;
+	// "hybrid" mode uses direct updates when at most this many pixels are selected
+	size_t direct_update_max_pixels;
 	
-	FourierTransformer fft;
-	FourierTransformer ifft;
-
-	std::vector<FourierTransformer::complex> psf_fft;
-	std::vector<FourierTransformer::complex> selected_px_fft;
-
-	std::string tag;
-	
-	// Historical status
+	// Historical status, always double whatever precision the algorithm uses
 	std::vector<double> fabs_record;
 	std::vector<double> rms_record;
 	std::vector<double> threshold_record;
 	size_t histogram_n_bins;
 	std::vector<double> histogram_edges;
 	std::vector<uint32_t> histogram_counts;
-	
-	// Temp variables
-	std::vector<double> temp_data;
 
-	// Otsu's method attributes
-	std::vector<short> indices;
-	//std::vector<double> mean
+	// Otsu's method attributes, a histogram of |residual| in 'otsu_n_bins' equal bins
+	// from zero to the brightest pixel
+	size_t otsu_n_bins;
+	std::vector<uint32_t> otsu_histogram;
+
+	// Iterations run since the observations were prepared, 'run()' continues from here
+	size_t n_iter_done;
+	// True once an iteration's stopping criteria ended the run, 'run()' does no more
+	bool stopping_criteria_met;
 
-	CleanModifiedAlgorithm(
+	CleanModifiedAlgorithmBase(
 		size_t _n_iter = 1000,
 		size_t _n_positive_iter = 0,
 		double _loop_gain = 0.1,
@@ -123,20 +329,157 @@ class CleanModifiedAlgorithm {
 		double _fabs_frac_threshold = 1E-2
 	);
 
-	void _get_residual_from_obs(const std::vector<double>& obs_data, const std::vector<size_t>& obs_shape);
-	void _get_padded_psf(const std::vector<double>& psf_data, const std::vector<size_t>& psf_shape, const std::string& centering_mode);
+	bool _use_direct_update() const;
+	// Full-frame transforms of the PSF are used for updates, i.e., not in "tiled" or "separable" mode
+	bool _uses_psf_spectrum() const;
+
+	// Smallest shape at least as large as the observation and the PSF whose axes are
+	// FFT friendly sizes, see 'next_fast_fft_size()'. The PSF must fit in the frame so
+	// it can be centred on pixel 0.
+	std::vector<size_t> _get_working_shape(const std::vector<size_t>& obs_shape, const std::vector<size_t>& psf_shape) const;
+};
+
+
+// 'T' is the precision of the data and transforms, double or float
+template<class T=double>
+class CleanModifiedAlgorithm : public CleanModifiedAlgorithmBase {
+	public:
+	using complex=typename FourierTransformer<T>::complex;
+
+	using CleanModifiedAlgorithmBase::CleanModifiedAlgorithmBase;
+
+	// Input data
+	std::vector<T> residual_data;
+	std::vector<T> components_data;
+	std::vector<T> clean_map;
+	// One for each of 'extra_clean_beam_sigmas'
+	std::vector<std::vector<T>> extra_clean_maps;
+	
+	// Internal state
+	// PSF as given to 'prepare_observations()', kept for checkpoints
+	std::vector<T> input_psf_data;
+	std::vector<size_t> input_psf_shape;
+	// Read-only, shared with every deconvolver that uses the same PSF, see 'PSFCache'
+	std::shared_ptr<const std::vector<T>> padded_psf_data;
+	// Frames of the selected pixels and their convolution with the PSF. They view the
+	// 'owned_' vectors unless a 'BatchedCleanModifiedAlgorithm' places them in its batch
+	// buffers, and are set again by every 'prepare_observations()'.
+	std::span<T> selected_pixels;
+	std::span<T> current_convolved;
+	std::vector<T> owned_selected_pixels;
+	std::vector<T> owned_current_convolved;
+	// Largest absolute values of the residual per tile, refreshed for the tiles each update
+	// touches. Gives the residual's brightest pixel and sum of squares without a full scan.
+	TileMaxPyramid<T> residual_peaks;
+	// Tiles of 'residual_peaks' that held selected pixels in the last iteration,
+	// 'selected_pixels' is zero outside them.
+	std::vector<size_t> selected_tiles;
+	// Rectangle (wrapping around the frame's edges) the last update wrote into
+	// 'current_convolved', which is zero outside it.
+	std::vector<size_t> convolved_box_offset;
+	std::vector<size_t> convolved_box_shape;
+
+	// Support of 'padded_psf_data' cropped to a rectangle, 'psf_stamp_offset' is the
+	// pixel of the stamp that sits on the PSF's origin (pixel 0 of 'padded_psf_data').
+	std::vector<T> psf_stamp;
+	// Convolves with 'psf_stamp' in "tiled" mode
+	TiledConvolver<T> tiled_convolver;
+	// Convolves with an approximation of 'psf_stamp' in "separable" mode
+	SeparableConvolver<T> separable_convolver;
+	
+	// Real-to-complex transformers, spectra only hold the non-redundant half.
+	// Not set up in "tiled" or "separable" mode until they are needed for the clean beam.
+	FourierTransformer<T> fft;
+	FourierTransformer<T> ifft;
+
+	// Has the 1/data_size normalisation of 'ifft' folded in, see 'FourierTransformer::convolve()'.
+	// Shared like 'padded_psf_data', null in "tiled" and "separable" modes and for symmetric PSFs.
+	std::shared_ptr<const std::vector<complex>> psf_fft;
+	// Used instead of 'psf_fft' when 'psf_is_symmetric', see 'psf_symmetry_tolerance'
+	std::shared_ptr<const std::vector<T>> psf_fft_real;
+	bool psf_is_symmetric;
+	std::vector<complex> selected_px_fft;
+	// Conjugate of 'psf_fft' for convolutions with the PSF's adjoint, only made by deconvolvers
+	// that need them (see '_prepare_psf_adjoint()'), empty for symmetric PSFs as their
+	// spectrum is real
+	std::vector<complex> psf_adjoint_fft;
+
+	// Temp variables
+	std::vector<T> temp_data;
+
+	std::string precision() const override;
+	std::string type_name() const override;
+
 	void __str__();
+	void _get_residual_from_obs(const std::vector<T>& obs_data, const std::vector<size_t>& obs_shape);
+	// Returns the PSF zero-padded to 'data_shape', normalised, and centred on pixel 0
+	std::vector<T> _get_padded_psf(const std::vector<T>& psf_data, const std::vector<size_t>& psf_shape, const std::string& centering_mode="center_of_brightness") const;
+	// Sets 'padded_psf_data', and 'psf_fft' or 'psf_fft_real' when 'needs_spectrum', from
+	// 'PSFCache' if possible. Otherwise makes them and adds them to the cache. The spectrum
+	// needs 'fft' and 'ifft' set to 'data_shape'.
+	void _prepare_psf(const std::vector<T>& psf_data, const std::vector<size_t>& psf_shape, bool needs_spectrum, const std::string& centering_mode="center_of_brightness");
+	// Largest difference between 'padded_psf' and its point reflection through pixel 0,
+	// as a fraction of the largest absolute value of 'padded_psf'
+	double _get_psf_asymmetry(const std::vector<T>& padded_psf) const;
 	void _calc_pixel_threshold();
+	// Writes 'loop_gain' times the residual into 'selected_pixels' where the residual's
+	// absolute value is above 'px_threshold', and zero elsewhere, in one pass over the tiles
+	// of 'residual_peaks' that can hold such pixels. Sets 'n_selected_pixels' and the
+	// selected box as it goes.
 	void _select_update_pixels();
+	void _get_psf_stamp();
+	// Crops 'psf', a frame centred on pixel 0 like 'padded_psf_data', to the rectangle holding
+	// every pixel whose absolute value is above 'support_threshold' times the largest, pixels
+	// at or below it are zeroed. 'stamp_offset' is the pixel of 'stamp' on pixel 0 of 'psf'.
+	void _crop_psf(const std::vector<T>& psf, double support_threshold, std::vector<T>& stamp, std::vector<size_t>& stamp_shape, std::vector<size_t>& stamp_offset) const;
+	void _calibrate_update_cost();
+
+	// Writes the circular convolution of 'pixels' with 'padded_psf_data' into 'output',
+	// only visiting the PSF stamp around each non-zero pixel.
+	void _add_psf_stamps(std::span<const T> pixels, std::span<T> output) const;
+	// As above, for 'pixels' that are zero outside the rectangle of 'box_shape' at
+	// 'box_offset'. Adds to 'output' rather than overwriting it.
+	void _add_psf_stamps(std::span<const T> pixels, std::span<T> output, const std::vector<size_t>& box_offset, const std::vector<size_t>& box_shape) const;
 
+	// Zero-pads the observation up to the working shape, see 'CleanModifiedAlgorithmBase::_get_working_shape()'
 	std::pair<
-		std::vector<double>,
+		std::vector<T>,
 		std::vector<size_t>
-	> _ensure_odd(const std::vector<double>& obs_data, const std::vector<size_t>& obs_shape);
+	> _pad_to_working_shape(const std::vector<T>& obs_data, const std::vector<size_t>& obs_shape, const std::vector<size_t>& psf_shape);
 
-	bool doIter(
+	virtual bool doIter(
 		size_t i
 	);
+
+	// The steps of 'doIter()', split so 'BatchedCleanModifiedAlgorithm' can do the
+	// convolution of several channels together.
+	// Finds the pixels to update and scales them by the loop gain
+	void _select_components();
+	// Convolves the selected pixels with the PSF into 'current_convolved'
+	void _convolve_components();
+	// Updates the residual and components, then '_record_progress()'. The updates and the
+	// reductions for the stopping criteria and 'residual_peaks' are one pass over the
+	// tiles the update touches.
+	bool _apply_update(size_t i);
+	// Records the stopping criteria from 'residual_peaks', and plots progress. Returns false
+	// when a stopping criterion is met.
+	bool _record_progress(size_t i);
+	// Uses a full-frame FFT for this iteration's convolution
+	bool _use_fft_update() const;
+	// Full-frame FFT convolution of 'pixels' with the PSF into 'output'
+	void _fft_convolve(std::span<const T> pixels, std::span<T> output);
+	// Makes 'psf_adjoint_fft' once the PSF is prepared
+	void _prepare_psf_adjoint();
+	// Full-frame FFT convolution of 'pixels' with the PSF reflected through pixel 0
+	void _fft_convolve_adjoint(std::span<const T> pixels, std::span<T> output);
+
+	// Makes 'clean_map' and 'extra_clean_maps' from the components once iterations are finished
+	void _make_clean_map();
+
+	// Convolves the components with a gaussian clean beam of standard deviation 'sigmas[k]'
+	// for each k, returning one map per beam. The beam is applied as its analytic transfer
+	// function so only one forward transform is needed, a sigma <= 0 returns the components.
+	std::vector<std::vector<T>> restore_clean_maps(const std::vector<double>& sigmas);
 	
 	void prepare_observations(
 		const std::span<double> obs_data, 
@@ -144,10 +487,345 @@ class CleanModifiedAlgorithm {
 		const std::span<double> psf_data, 
 		const std::span<size_t> psf_shape,
 		const std::string& run_tag=""
-	);
+	) override;
+	// The parts of 'prepare_observations()' a checkpoint does not replace.
+	// Sizes the working frames and the full-frame transformers to 'data_shape'
+	void _prepare_frames();
+	// Prepares the PSF, and what updates need of it, from 'input_psf_data'. "hybrid" mode
+	// times updates to set 'direct_update_max_pixels' when 'calibrate', otherwise keeps it.
+	void _prepare_psf_state(bool calibrate=true);
 	
-	void run();
+	void run() override;
+
+	// Checkpoints hold 'residual_data', 'components_data', the records, 'n_iter_done', and
+	// the parameters in 'CheckpointHeader'. Algorithms with more state than these return
+	// false from 'supports_checkpoints()'.
+	//
+	// Resuming does not pad the observation or find its residual, but still prepares the PSF
+	// state as 'prepare_observations()' does. On a 'PSFCache' miss that is padding the PSF and
+	// one full-frame transform of it (planned first for a new shape), then cropping the stamp,
+	// and for "tiled" or "separable" modes making their kernels. "hybrid" mode's calibration
+	// is not redone, the checkpoint holds its result.
+	bool supports_checkpoints() const override;
+	std::vector<std::byte> save_checkpoint() const override;
+	bool resume_from_checkpoint(std::span<const std::byte> checkpoint) override;
+
+	// Pads the observation into 'residual_data' and prepares the PSF's spectrum, without the
+	// working frames, stamps, calibration, or convolvers 'run()' needs
+	void prepare_preview(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	) override;
+
+	// Divides the observation's spectrum by the PSF's, regularised by 'preview_regularisation'
+	// (a Wiener filter assuming white noise and signal, equivalently Tikhonov regularisation),
+	// and multiplies by the clean beam's transfer function into 'clean_map'. One forward and
+	// one inverse transform, using 'psf_fft' (or 'psf_fft_real') when it is prepared. Refused
+	// once 'n_iter_done' is non-zero, as the residual is no longer the observation.
+	void preview() override;
+
+	std::vector<double> get_clean_map() const override;
+	std::vector<double> get_residual() const override;
+	size_t n_extra_clean_maps() const override;
+	std::vector<double> get_extra_clean_map(size_t k) const override;
+};
+
+
+// Classic Hogbom CLEAN, each iteration subtracts 'loop_gain' times the PSF stamp at the
+// residual's brightest pixel. 'residual_peaks' finds the pixel and only the tiles under the
+// stamp are updated, so an iteration costs about the stamp's size. Suits fields of a few
+// point sources, 'n_iter' needs to be about the number of sources over 'loop_gain'.
+// Updates are always direct, 'update_mode' is set to "direct" when observations are prepared,
+// 'psf_support_threshold' crops the stamp as usual. 'threshold' is not used.
+template<class T=double>
+class HogbomCleanAlgorithm : public CleanModifiedAlgorithm<T> {
+	public:
+	using CleanModifiedAlgorithm<T>::CleanModifiedAlgorithm;
+
+	// The PSF has unit sum, components are the peak over the PSF's maximum so each
+	// subtraction removes 'loop_gain' of the peak
+	T psf_peak;
+
+	std::string type_name() const override;
+	bool doIter(size_t i) override;
+	// Also remakes 'psf_peak', the checkpoint holds the "direct" update mode
+	bool resume_from_checkpoint(std::span<const std::byte> checkpoint) override;
+
+	void prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	) override;
+};
+
+
+// Clark CLEAN, each iteration is one major cycle made of many cheap minor cycle steps.
+// The minor cycle works on a copy of the residual, repeatedly subtracting 'loop_gain' times
+// a small patch of the PSF (see 'clark_psf_patch_threshold') at its brightest pixel while
+// that is above the larger of the pixel threshold (see 'threshold') and
+// 'clark_psf_patch_threshold' times the peak the minor cycle started from. Only the tiles
+// under the patch are re-scanned for the next peak. The major cycle then subtracts the exact
+// convolution of the components found, using one full-frame FFT, from the residual.
+// 'update_mode' is set to "fft" when observations are prepared.
+//
+// The minor cycle leaves out the PSF outside the patch. Once the residual is mostly noise
+// a major cycle can add more than it removes, so by default iterations stop when the root
+// mean square of the residual increases (see 'clark_stop_on_rms_increase').
+template<class T=double>
+class ClarkCleanAlgorithm : public CleanModifiedAlgorithm<T> {
+	public:
+	using CleanModifiedAlgorithm<T>::CleanModifiedAlgorithm;
+
+	// PSF cropped to the minor cycle's patch, as 'psf_stamp'
+	std::vector<T> psf_patch;
+	std::vector<size_t> psf_patch_shape;
+	std::vector<size_t> psf_patch_offset;
+	// As 'HogbomCleanAlgorithm::psf_peak'
+	T psf_peak;
+	// The residual as the minor cycle subtracts patches from it, and its peaks
+	std::vector<T> minor_residual;
+	TileMaxPyramid<T> minor_peaks;
+
+	std::string type_name() const override;
+	bool doIter(size_t i) override;
+	// Also remakes the PSF patch and 'psf_peak', the checkpoint holds the "fft" update mode
+	bool resume_from_checkpoint(std::span<const std::byte> checkpoint) override;
+
+	void prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	) override;
+
+	// Subtracts patches at the brightest pixel of 'minor_residual', adding the components to
+	// 'selected_pixels', until it is at or below 'cycle_threshold' or 'clark_max_minor_iter'
+	// are done
+	void _minor_cycle(T cycle_threshold);
+};
+
+
+// Multi-scale CLEAN, components are gaussian blobs of the standard deviations in
+// 'multiscale_sigmas' rather than points, so extended emission is modelled in far fewer
+// iterations. The residual convolved with each scale kernel is kept, made from one transform
+// of the residual when observations are prepared. The PSF convolved with each pair of scale
+// kernels is also made then, and cropped to stamps. Each iteration finds the peak of every
+// scale's residual and picks the scale whose component there would best fit the residual
+// (weighted, see 'multiscale_bias'). It adds 'loop_gain' of that component and subtracts the
+// matching stamps from the residual and from every scale's residual. No transforms are
+// needed while iterating, except to remake the scale residuals every
+// 'multiscale_refresh_interval' iterations.
+// 'update_mode' is set to "fft" when observations are prepared, 'threshold' is not used.
+template<class T=double>
+class MultiScaleCleanAlgorithm : public CleanModifiedAlgorithm<T> {
+	public:
+	using complex=typename CleanModifiedAlgorithm<T>::complex;
+
+	using CleanModifiedAlgorithm<T>::CleanModifiedAlgorithm;
+
+	// Transfer functions along x and y of each scale kernel, see 'set_gaussian_transfer_function()',
+	// followed by those of a point
+	std::vector<std::vector<T>> scale_transfer_x;
+	std::vector<std::vector<T>> scale_transfer_y;
+	// The residual convolved with each scale kernel, and their peaks
+	std::vector<std::vector<T>> scale_residuals;
+	std::vector<TileMaxPyramid<T>> scale_peaks;
+	std::vector<T> scale_weights;
+	// For each scale, the PSF convolved with the scale kernel cropped to a stamp (as
+	// 'psf_stamp'), and the scale kernel over the same rectangle. These are what one
+	// component of that scale adds to 'current_convolved' and 'selected_pixels'.
+	std::vector<std::vector<T>> scale_psf_stamps;
+	std::vector<std::vector<T>> scale_kernel_stamps;
+	std::vector<std::vector<size_t>> scale_psf_stamp_shapes;
+	std::vector<std::vector<size_t>> scale_psf_stamp_offsets;
+	// The PSF convolved with the kernels of scales s and t, cropped to a stamp, is entry
+	// s + t*n_scales. A component of scale t subtracts it from the residual of scale s.
+	std::vector<std::vector<T>> cross_psf_stamps;
+	std::vector<std::vector<size_t>> cross_psf_stamp_shapes;
+	std::vector<std::vector<size_t>> cross_psf_stamp_offsets;
+	// Largest absolute value of the PSF convolved with the kernel of scale t twice, a
+	// component of scale t is the peak over this so it removes 'loop_gain' of the peak
+	std::vector<T> scale_psf_peaks;
+
+	std::string type_name() const override;
+	bool doIter(size_t i) override;
+
+	void prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	) override;
+	// Keeps more state than a checkpoint holds
+	bool supports_checkpoints() const override;
+
+	// Inverse transform into 'frame' of 'spectrum' times the transfer functions of scales 's'
+	// and 't', either can be the point after the last scale
+	void _filter_and_invert(const std::vector<complex>& spectrum, size_t s, size_t t, std::vector<T>& frame);
+	// Makes 'scale_residuals' and 'scale_peaks' from 'residual_data' with one transform
+	void _refresh_scale_residuals();
+};
+
+
+// Richardson-Lucy deconvolution, for non-negative data such as microscopy images. Each
+// iteration multiplies the estimate (held in 'components_data') by the ratio of the
+// observation to the estimate convolved with the PSF, convolved with the PSF's adjoint.
+// These are two full-frame FFT convolutions with 'psf_fft' (or 'psf_fft_real'). With
+// 'richardson_lucy_acceleration' each iteration starts from the estimate extrapolated along
+// the last step, by a step size from the correlation of the last two steps (Biggs and
+// Andrews 1997), which usually needs several times fewer iterations.
+// The clean map is the estimate, restored with the clean beam as usual. While iterating
+// 'residual_data' is the observation minus the convolved prediction, once iterations finish
+// it is the residual of the final estimate. 'update_mode' is set to "fft" when observations
+// are prepared, 'loop_gain' and 'threshold' are not used.
+template<class T=double>
+class RichardsonLucyAlgorithm : public CleanModifiedAlgorithm<T> {
+	public:
+	using CleanModifiedAlgorithm<T>::CleanModifiedAlgorithm;
+
+	// Observation with NaNs set to zero
+	std::vector<T> observed_data;
+	// Estimate of the last iteration, and the prediction this iteration starts from
+	std::vector<T> previous_estimate;
+	std::vector<T> prediction;
+	// Prediction convolved with the PSF, the observation over it, and that ratio
+	// convolved with the PSF's adjoint
+	std::vector<T> predicted_obs;
+	std::vector<T> ratio;
+	std::vector<T> correction;
+	// Change the last iteration made to its prediction, and the extrapolation step size
+	// for the next
+	std::vector<T> step;
+	T acceleration;
+
+	std::string type_name() const override;
+	bool doIter(size_t i) override;
+
+	void prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	) override;
+	// Keeps more state than a checkpoint holds
+	bool supports_checkpoints() const override;
+};
+
+
+// Sparse regularised deconvolution by FISTA (fast iterative shrinkage-thresholding, Beck and
+// Teboulle 2009). Minimises half the sum of squares of the residual plus an L1 norm of the
+// estimate weighted by 'fista_l1_weight', optionally keeping the estimate non-negative
+// ('fista_positive'). Each iteration is one convolution with the PSF and one with its
+// adjoint, using 'psf_fft' (or 'psf_fft_real'), followed by one pass for the proximal
+// (soft threshold and clip) step. Momentum from the last step makes the objective converge
+// as O(1/k^2) instead of the O(1/k) of plain gradient steps. The momentum is restarted when
+// it points against the last step (O'Donoghue and Candes 2015).
+// The estimate is held in 'components_data' and restored with the clean beam as usual, the
+// residual is found as for 'RichardsonLucyAlgorithm'. 'update_mode' is set to "fft" when
+// observations are prepared, 'loop_gain' and 'threshold' are not used.
+template<class T=double>
+class FistaAlgorithm : public CleanModifiedAlgorithm<T> {
+	public:
+	using CleanModifiedAlgorithm<T>::CleanModifiedAlgorithm;
+
+	// Observation with NaNs set to zero
+	std::vector<T> observed_data;
+	// Estimate of the last iteration, and the point this iteration steps from
+	std::vector<T> previous_estimate;
+	std::vector<T> momentum_point;
+	// Momentum point convolved with the PSF, and the residual there convolved with the
+	// PSF's adjoint (the negative gradient)
+	std::vector<T> predicted_obs;
+	std::vector<T> gradient;
+	// Step size, one over the largest eigenvalue of convolving with the PSF then its adjoint,
+	// and the soft threshold of the proximal step
+	T step_size;
+	T l1_threshold;
+	// Momentum sequence
+	double momentum_t;
+
+	std::string type_name() const override;
+	bool doIter(size_t i) override;
+
+	void prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	) override;
+	// Keeps more state than a checkpoint holds
+	bool supports_checkpoints() const override;
+};
+
+
+// Deconvolves every colour channel of an image together. Each channel is a
+// 'CleanModifiedAlgorithm' with the parameters of this object, they are iterated in
+// lock step so the full-frame FFT updates of all channels are done by one batched
+// transform over the planar (RRR...GGG...BBB...) layout 'Image' uses. Channels that have
+// met a stopping criterion, or use direct, tiled, or separable updates, are left out of the batch.
+template<class T=double>
+class BatchedCleanModifiedAlgorithm : public CleanModifiedAlgorithmBase {
+	public:
+	using complex=typename FourierTransformer<T>::complex;
+
+	using CleanModifiedAlgorithmBase::CleanModifiedAlgorithmBase;
+
+	std::vector<CleanModifiedAlgorithm<T>> channels;
+	std::vector<bool> channel_continue;
+
+	// Batched transformers, and buffers holding 'n_channels' frames (or spectra) one
+	// after another. 'batch_psf_fft' has the 1/data_size normalisation folded in, it is the
+	// first channel's 'psf_fft' when all channels share a PSF. 'batch_psf_fft_real' is used
+	// instead when every channel's PSF is symmetric. Each channel's 'selected_pixels' and
+	// 'current_convolved' view its frame of 'batch_pixels' and 'batch_convolved'.
+	FourierTransformer<T> fft;
+	FourierTransformer<T> ifft;
+	std::vector<T> batch_pixels;
+	std::vector<complex> batch_px_fft;
+	std::shared_ptr<const std::vector<complex>> batch_psf_fft;
+	std::shared_ptr<const std::vector<T>> batch_psf_fft_real;
+	std::vector<T> batch_convolved;
+
+	std::string precision() const override;
+	std::string type_name() const override;
+	bool handles_all_channels() const override;
+
+	bool doIter(size_t i);
+
+	// 'obs_shape' is {x, y, channels}, 'psf_shape' is {x, y, channels} or {x, y, 1} when
+	// one PSF is used for all channels.
+	void prepare_observations(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	) override;
+
+	void run() override;
+	// Prepares and previews each channel separately
+	void prepare_preview(
+		const std::span<double> obs_data, 
+		const std::span<size_t> obs_shape, 
+		const std::span<double> psf_data, 
+		const std::span<size_t> psf_shape,
+		const std::string& run_tag=""
+	) override;
+	void preview() override;
 
+	std::vector<double> get_clean_map() const override;
+	std::vector<double> get_residual() const override;
+	size_t n_extra_clean_maps() const override;
+	std::vector<double> get_extra_clean_map(size_t k) const override;
 };
 
 
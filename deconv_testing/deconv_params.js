@@ -443,7 +443,8 @@ class CleanModifiedParameters{
 		),
 		new Parameter(
 			"clean_beam_sigma", 
-			"The standard deviation (in pixels) of the gaussian 'clean beam' to convolve source components with, forming the 'clean map'. If zero, no clean beam is used. Recommended to be non-zero only if altering other parameters does not give a physically plausible result.", 
+			"The standard deviation (in pixels) of the gaussian 'clean beam' to convolve source components with, forming the 'clean map'. If zero, no clean beam is used. Recommended to be non-zero only if altering other parameters does not give a physically plausible result. "
+			+ "Earlier versions used a beam of standard deviation <em>clean_beam_sigma</em>/&radic;2, divide values chosen for them by &radic;2 to get the same beam.", 
 			"real", 
 			Number, 
 			0
@@ -1,49 +1,646 @@
 #include "fft.hpp"
+#include <chrono>
+#include <atomic>
+#include <limits>
+
+
+#if FFT_FFTW_ENABLED
+unsigned plan_rigor_flags(const PlanRigor rigor){
+	switch(rigor){
+		case PlanRigor::ESTIMATE:
+			return FFTW_ESTIMATE;
+		case PlanRigor::MEASURE:
+			return FFTW_MEASURE;
+		case PlanRigor::PATIENT:
+			return FFTW_PATIENT;
+		case PlanRigor::EXHAUSTIVE:
+			return FFTW_EXHAUSTIVE;
+	}
+	return FFTW_ESTIMATE;
+}
+#endif
+
+PlanRigor plan_rigor_from_string(const std::string& name){
+	GET_LOGGER;
+	if (name == "estimate") return PlanRigor::ESTIMATE;
+	if (name == "measure") return PlanRigor::MEASURE;
+	if (name == "patient") return PlanRigor::PATIENT;
+	if (name == "exhaustive") return PlanRigor::EXHAUSTIVE;
+	LOG_WARN("Unknown plan rigor '%', should be one of {estimate, measure, patient, exhaustive}. Using 'estimate'.", name);
+	return PlanRigor::ESTIMATE;
+}
+
+FFTBackend fft_backend_from_string(const std::string& name){
+	GET_LOGGER;
+	if (name == "fftw") return FFTBackend::FFTW;
+	if (name == "mixed_radix") return FFTBackend::MIXED_RADIX;
+	if (name == "auto") return FFTBackend::AUTO;
+	LOG_WARN("Unknown FFT backend '%', should be one of {fftw, mixed_radix, auto}. Using 'auto'.", name);
+	return FFTBackend::AUTO;
+}
+
+std::string fft_backend_name(const FFTBackend backend){
+	switch(backend){
+		case FFTBackend::FFTW:
+			return "fftw";
+		case FFTBackend::MIXED_RADIX:
+			return "mixed_radix";
+		case FFTBackend::AUTO:
+			return "auto";
+	}
+	return "auto";
+}
+
+// function-local so it is set before any statically constructed transformer is planned
+std::atomic<FFTBackend>& _fft_backend(){
+	static std::atomic<FFTBackend> backend(FFTBackend::AUTO);
+	return backend;
+}
+
+void set_fft_backend(const FFTBackend backend){
+	GET_LOGGER;
+	if (!FFT_FFTW_ENABLED && (backend == FFTBackend::FFTW)){
+		LOG_WARN("Built without FFTW, transforms will use the mixed radix backend.");
+	}
+	_fft_backend() = backend;
+}
+
+FFTBackend get_fft_backend(){
+	return FFT_FFTW_ENABLED ? _fft_backend().load() : FFTBackend::MIXED_RADIX;
+}
+
+size_t next_fast_fft_size(size_t n){
+	if (n <= 1){
+		return 1;
+	}
+	for(;; ++n){
+		size_t m = n;
+		for(size_t p : {2, 3, 5, 7}){
+			while(m%p == 0){
+				m /= p;
+			}
+		}
+		if (m == 1){
+			return n;
+		}
+	}
+}
+
+int fft_n_threads([[maybe_unused]] size_t n_threads){
+	#if FFT_THREADS_ENABLED
+		if (n_threads == 0){
+			n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		return static_cast<int>(n_threads);
+	#else
+		return 1;
+	#endif
+}
+
+
+#if FFT_FFTW_ENABLED
+namespace FFTPlanCache{
+	// function-local so the cache exists before any statically constructed transformer uses it
+	template<class T>
+	std::map<PlanKey, Plan<T>>& _plans(){
+		static std::map<PlanKey, Plan<T>> plans;
+		return plans;
+	}
+
+	// guards '_plans()' and every call into FFTW's planner and wisdom
+	std::mutex& _mutex(){
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	template<class T>
+	typename FFTW<T>::plan_t make_plan(const PlanKey& key){
+		using fftw_complex_t = typename FFTW<T>::complex_t;
+
+		// Plan on scratch arrays that have the alignment given in 'key'
+		const size_t size = du::product(key.shape);
+		size_t spectrum_size = size;
+		if (key.real_transform && (key.shape.size() > 0)){
+			spectrum_size = (size/key.shape.back())*(key.shape.back()/2 + 1);
+		}
+		const size_t real_bytes = sizeof(T)*size*key.n_batch;
+		const size_t complex_bytes = sizeof(fftw_complex_t)*spectrum_size*key.n_batch;
+		const size_t in_bytes = (key.real_transform && !key.inverse) ? real_bytes : complex_bytes;
+		const size_t out_bytes = (key.real_transform && key.inverse) ? real_bytes : complex_bytes;
+		constexpr size_t padding = 64; // larger than any SIMD alignment FFTW uses
+
+		char* in_block = static_cast<char*>(FFTW<T>::malloc(in_bytes + padding));
+		char* out_block = static_cast<char*>(FFTW<T>::malloc(out_bytes + padding));
+		void* in = in_block + key.in_alignment;
+		void* out = out_block + key.out_alignment;
+
+		std::vector<int> n = du::as_type<int>(key.shape);
+		const unsigned flags = plan_rigor_flags(key.rigor);
+		typename FFTW<T>::plan_t plan;
+
+		#if FFT_THREADS_ENABLED
+			static bool threads_initialised = false;
+			if (!threads_initialised){
+				FFTW<T>::init_threads();
+				threads_initialised = true;
+			}
+			FFTW<T>::plan_with_nthreads(key.n_threads);
+		#endif
+
+		if (key.n_batch > 1){
+			// Arrays of the batch are contiguous and follow one another, i.e., stride 1
+			// and a distance of one array between them. nullptr 'nembed' means not embedded.
+			const int real_dist = static_cast<int>(size);
+			const int complex_dist = static_cast<int>(spectrum_size);
+			if (!key.real_transform){
+				plan = FFTW<T>::plan_many_dft(
+					n.size(), n.data(), key.n_batch,
+					static_cast<fftw_complex_t*>(in), nullptr, 1, complex_dist,
+					static_cast<fftw_complex_t*>(out), nullptr, 1, complex_dist,
+					(key.inverse) ? FFTW_BACKWARD : FFTW_FORWARD,
+					flags
+				);
+			}
+			else if (!key.inverse){
+				plan = FFTW<T>::plan_many_dft_r2c(
+					n.size(), n.data(), key.n_batch,
+					static_cast<T*>(in), nullptr, 1, real_dist,
+					static_cast<fftw_complex_t*>(out), nullptr, 1, complex_dist,
+					flags
+				);
+			}
+			else {
+				plan = FFTW<T>::plan_many_dft_c2r(
+					n.size(), n.data(), key.n_batch,
+					static_cast<fftw_complex_t*>(in), nullptr, 1, complex_dist,
+					static_cast<T*>(out), nullptr, 1, real_dist,
+					flags
+				);
+			}
+		}
+		else if (!key.real_transform){
+			plan = FFTW<T>::plan_dft(
+				n.size(),
+				n.data(),
+				static_cast<fftw_complex_t*>(in),
+				static_cast<fftw_complex_t*>(out),
+				(key.inverse) ? FFTW_BACKWARD : FFTW_FORWARD,
+				flags
+			);
+		}
+		else if (!key.inverse){
+			plan = FFTW<T>::plan_dft_r2c(
+				n.size(),
+				n.data(),
+				static_cast<T*>(in),
+				static_cast<fftw_complex_t*>(out),
+				flags
+			);
+		}
+		else {
+			// NOTE: complex-to-real transforms overwrite their input array
+			plan = FFTW<T>::plan_dft_c2r(
+				n.size(),
+				n.data(),
+				static_cast<fftw_complex_t*>(in),
+				static_cast<T*>(out),
+				flags
+			);
+		}
+
+		FFTW<T>::free(in_block);
+		FFTW<T>::free(out_block);
+		return plan;
+	}
+
+	template<class T>
+	Plan<T> get(const PlanKey& key){
+		GET_LOGGER;
+		std::lock_guard<std::mutex> lock(_mutex());
+		std::map<PlanKey, Plan<T>>& plans = _plans<T>();
+		PlanKey search_key(key);
+
+		// Any plan that is at least as rigorous as the one asked for will do
+		for(int r=static_cast<int>(PlanRigor::EXHAUSTIVE); r >= static_cast<int>(key.rigor); --r){
+			search_key.rigor = static_cast<PlanRigor>(r);
+			auto it = plans.find(search_key);
+			if (it != plans.end()){
+				return it->second;
+			}
+		}
+
+		LOG_DEBUG("Creating new % precision plan for shape % batches %", FFTPrecision<T>::name, key.shape, key.n_batch);
+		typename FFTW<T>::plan_t raw_plan = make_plan<T>(key);
+		if (raw_plan == nullptr){
+			LOG_ERROR("FFTW could not create a plan for shape %", key.shape);
+			return nullptr;
+		}
+		// 'destroy_plan' is not thread-safe either, so it takes the planner's mutex.
+		// Plans are never released while the mutex is held, see 'clear()'.
+		Plan<T> plan(raw_plan, [](typename FFTW<T>::plan_t p){
+			std::lock_guard<std::mutex> destroy_lock(_mutex());
+			FFTW<T>::destroy_plan(p);
+		});
+		plans[key] = plan;
+		return plan;
+	}
+
+	size_t size(){
+		std::lock_guard<std::mutex> lock(_mutex());
+		return _plans<double>().size() + _plans<float>().size();
+	}
+
+	void clear(){
+		// Swapped out under the lock and released after it, as releasing may destroy plans
+		std::map<PlanKey, Plan<double>> double_plans;
+		std::map<PlanKey, Plan<float>> float_plans;
+		{
+			std::lock_guard<std::mutex> lock(_mutex());
+			double_plans.swap(_plans<double>());
+			float_plans.swap(_plans<float>());
+		}
+	}
+
+	template<class T>
+	bool import_wisdom(const std::string& wisdom){
+		if (wisdom.size() == 0){
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(_mutex());
+		return FFTW<T>::import_wisdom_from_string(wisdom.c_str()) != 0;
+	}
+
+	template<class T>
+	std::string export_wisdom(){
+		std::lock_guard<std::mutex> lock(_mutex());
+		char* wisdom_cstr = FFTW<T>::export_wisdom_to_string();
+		if (wisdom_cstr == nullptr){
+			return "";
+		}
+		std::string wisdom(wisdom_cstr);
+		free(wisdom_cstr); // FFTW allocates the string with malloc
+		return wisdom;
+	}
+
+	template<class T>
+	bool import_wisdom_from_file(const std::string& path){
+		std::lock_guard<std::mutex> lock(_mutex());
+		return FFTW<T>::import_wisdom_from_filename(path.c_str()) != 0;
+	}
+
+	template<class T>
+	bool export_wisdom_to_file(const std::string& path){
+		std::lock_guard<std::mutex> lock(_mutex());
+		return FFTW<T>::export_wisdom_to_filename(path.c_str()) != 0;
+	}
+
+	template Plan<double> get<double>(const PlanKey& key);
+	template Plan<float> get<float>(const PlanKey& key);
+	template bool import_wisdom<double>(const std::string& wisdom);
+	template bool import_wisdom<float>(const std::string& wisdom);
+	template std::string export_wisdom<double>();
+	template std::string export_wisdom<float>();
+	template bool import_wisdom_from_file<double>(const std::string& path);
+	template bool import_wisdom_from_file<float>(const std::string& path);
+	template bool export_wisdom_to_file<double>(const std::string& path);
+	template bool export_wisdom_to_file<float>(const std::string& path);
+}
+#else
+namespace FFTPlanCache{
+	size_t size(){
+		return 0;
+	}
+
+	void clear(){}
+
+	template<class T>
+	bool import_wisdom(const std::string& wisdom){
+		return false;
+	}
+
+	template<class T>
+	std::string export_wisdom(){
+		return "";
+	}
+
+	template<class T>
+	bool import_wisdom_from_file(const std::string& path){
+		return false;
+	}
+
+	template<class T>
+	bool export_wisdom_to_file(const std::string& path){
+		return false;
+	}
+
+	template bool import_wisdom<double>(const std::string& wisdom);
+	template bool import_wisdom<float>(const std::string& wisdom);
+	template std::string export_wisdom<double>();
+	template std::string export_wisdom<float>();
+	template bool import_wisdom_from_file<double>(const std::string& path);
+	template bool import_wisdom_from_file<float>(const std::string& path);
+	template bool export_wisdom_to_file<double>(const std::string& path);
+	template bool export_wisdom_to_file<float>(const std::string& path);
+}
+#endif
+
+
+// Backends chosen by 'FourierTransformer::_calibrate_backend()', keyed by plan key with
+// zero alignments.
+namespace FFTBackendCalibration{
+	template<class T>
+	std::map<FFTPlanCache::PlanKey, FFTBackend>& _choices(){
+		static std::map<FFTPlanCache::PlanKey, FFTBackend> choices;
+		return choices;
+	}
+
+	std::mutex& _mutex(){
+		static std::mutex mutex;
+		return mutex;
+	}
+}
 
 
 // TODO: 
 // * Document quirks, e.g., centering is around 1st pixel when convolving
-FourierTransformer::FourierTransformer(
+template<class T>
+FourierTransformer<T>::FourierTransformer(
 		const std::vector<size_t>& _shape,
 		const bool _inverse,
-		const bool _plan_measure
-	) : shape(du::reverse(_shape)), size(du::product(shape)), inverse(_inverse), plan_measure(_plan_measure)
+		const PlanRigor _plan_rigor,
+		const bool _real_transform,
+		const size_t _n_threads,
+		const size_t _n_batch
+	) : shape(du::reverse(_shape)), size(du::product(shape)), inverse(_inverse), plan_rigor(_plan_rigor), real_transform(_real_transform), n_threads(_n_threads), n_batch(_n_batch)
 {
 	get_plan();
 }
 
-void FourierTransformer::set_attrs(
+template<class T>
+void FourierTransformer<T>::set_attrs(
 	const std::vector<size_t>& _shape,
 	const bool _inverse,
-	const bool _plan_measure
+	const PlanRigor _plan_rigor,
+	const bool _real_transform,
+	const size_t _n_threads,
+	const size_t _n_batch
 ){
 	GET_LOGGER;
 	shape = du::reverse(_shape);
 
 	size = du::product(shape);
 	inverse = _inverse;
-	plan_measure = _plan_measure;
-	LOGV_DEBUG(shape, size, inverse, plan_measure);
+	plan_rigor = _plan_rigor;
+	real_transform = _real_transform;
+	n_threads = _n_threads;
+	n_batch = _n_batch;
+	LOGV_DEBUG(shape, size, inverse, static_cast<int>(plan_rigor), real_transform, n_threads, n_batch);
 
 	get_plan();
 }
 
-void FourierTransformer::get_plan(){
+template<class T>
+void FourierTransformer<T>::get_plan(){
 	GET_LOGGER;
 
-	in.resize(du::product(shape));
-	out.resize(in.size());
+	// 'shape' is in FFTW order (slowest varying axis first), so for real transforms
+	// the last axis is the one that is halved.
+	spectrum_shape = shape;
+	if (real_transform && (spectrum_shape.size() > 0)){
+		spectrum_shape.back() = spectrum_shape.back()/2 + 1;
+	}
+	spectrum_size = du::product(spectrum_shape);
+
+	// Release buffers of any previous shape, '_allocate_buffers()' re-creates them if needed
+	in.clear();
+	out.clear();
+	real_buffer.clear();
+
 	LOG_DEBUG("Getting Plan");
-	plan = fftw_plan_dft(
-		shape.size(),
-		du::as_type<int>(shape).data(),
-		reinterpret_cast<fftw_complex*>(in.data()),
-		reinterpret_cast<fftw_complex*>(out.data()),
-		(inverse) ? FFTW_BACKWARD : FFTW_FORWARD,
-		(plan_measure) ? FFTW_MEASURE : FFTW_ESTIMATE
+	// Assume fully aligned buffers, '_ensure_plan_alignment()' swaps plans if they are not.
+	plan_key = FFTPlanCache::PlanKey{shape, inverse, real_transform, plan_rigor, 0, 0, fft_n_threads(n_threads), static_cast<int>(n_batch)};
+	backend = get_fft_backend();
+	if (backend == FFTBackend::AUTO){
+		// nothing to time for unset transformers
+		backend = (shape.size() > 0) ? _calibrate_backend() : (FFT_FFTW_ENABLED ? FFTBackend::FFTW : FFTBackend::MIXED_RADIX);
+	}
+	_prepare_backend();
+}
+
+template<class T>
+void FourierTransformer<T>::_prepare_backend(){
+	if (backend == FFTBackend::MIXED_RADIX){
+		mixed_radix_plan = std::make_shared<const MixedRadixFFT<T>>(shape, inverse, real_transform, n_batch);
+		return;
+	}
+	mixed_radix_plan = nullptr;
+	#if FFT_FFTW_ENABLED
+	plan = FFTPlanCache::get<T>(plan_key);
+	#endif
+}
+
+template<class T>
+FFTBackend FourierTransformer<T>::_calibrate_backend(){
+	GET_LOGGER;
+	{
+		std::lock_guard<std::mutex> lock(FFTBackendCalibration::_mutex());
+		auto it = FFTBackendCalibration::_choices<T>().find(plan_key);
+		if (it != FFTBackendCalibration::_choices<T>().end()){
+			return it->second;
+		}
+	}
+
+	// Zeroed buffers, so repeated complex-to-real transforms of their own output stay finite
+	_allocate_buffers();
+	std::map<FFTBackend, double> seconds_per_transform;
+	for(const FFTBackend candidate : {FFTBackend::FFTW, FFTBackend::MIXED_RADIX}){
+		if ((candidate == FFTBackend::MIXED_RADIX) && (MixedRadixFFT<T>::largest_prime_factor(shape) > MixedRadixFFT<T>::max_fast_radix)){
+			// not worth timing, its direct DFTs of large prime factors are far slower than FFTW
+			seconds_per_transform[candidate] = std::numeric_limits<double>::infinity();
+			continue;
+		}
+		backend = candidate;
+		_prepare_backend();
+		execute(); // first execution may be slower, e.g., page faults in the buffers
+
+		// Repeat until long enough to time reliably, but keep calibration short
+		size_t n_calls = 0;
+		const auto start = std::chrono::steady_clock::now();
+		std::chrono::duration<double> elapsed(0);
+		do {
+			execute();
+			++n_calls;
+			elapsed = std::chrono::steady_clock::now() - start;
+		} while ((elapsed.count() < 2E-3) && (n_calls < 64));
+		seconds_per_transform[candidate] = elapsed.count()/n_calls;
+	}
+	in.clear();
+	out.clear();
+	real_buffer.clear();
+
+	const FFTBackend fastest = (seconds_per_transform[FFTBackend::MIXED_RADIX] < seconds_per_transform[FFTBackend::FFTW]) ? FFTBackend::MIXED_RADIX : FFTBackend::FFTW;
+	LOG_INFO(
+		"% precision transform of shape % batches %: fftw % s, mixed_radix % s, using %", 
+		FFTPrecision<T>::name, 
+		shape, 
+		n_batch, 
+		seconds_per_transform[FFTBackend::FFTW], 
+		seconds_per_transform[FFTBackend::MIXED_RADIX], 
+		fft_backend_name(fastest)
 	);
+
+	std::lock_guard<std::mutex> lock(FFTBackendCalibration::_mutex());
+	FFTBackendCalibration::_choices<T>()[plan_key] = fastest;
+	return fastest;
 }
 
+template<class T>
+void FourierTransformer<T>::_allocate_buffers(){
+	if (real_transform){
+		real_buffer.resize(n_batch*size);
+		in.resize(inverse ? n_batch*spectrum_size : 0);
+		out.resize(inverse ? 0 : n_batch*spectrum_size);
+	} else {
+		in.resize(n_batch*size);
+		out.resize(n_batch*size);
+	}
+}
 
+template<class T>
+void FourierTransformer<T>::_ensure_plan_alignment(const void* in_ptr, const void* out_ptr){
+	#if FFT_FFTW_ENABLED
+	const int in_alignment = FFTW<T>::alignment_of(static_cast<T*>(const_cast<void*>(in_ptr)));
+	const int out_alignment = FFTW<T>::alignment_of(static_cast<T*>(const_cast<void*>(out_ptr)));
+	if ((in_alignment != plan_key.in_alignment) || (out_alignment != plan_key.out_alignment)){
+		plan_key.in_alignment = in_alignment;
+		plan_key.out_alignment = out_alignment;
+		plan = FFTPlanCache::get<T>(plan_key);
+	}
+	#endif
+}
+
+template<class T>
+void FourierTransformer<T>::execute(){
+	if (!real_transform){
+		execute(std::span<const complex>(in), std::span<complex>(out));
+	}
+	else if (!inverse){
+		execute(std::span<const T>(real_buffer), std::span<complex>(out));
+	}
+	else {
+		execute(std::span<complex>(in), std::span<T>(real_buffer));
+	}
+}
+
+template<class T>
+void FourierTransformer<T>::execute(std::span<const complex> input, std::span<complex> output){
+	assert(!real_transform);
+	assert((input.size() == n_batch*size) && (output.size() == n_batch*size));
+	if (backend == FFTBackend::MIXED_RADIX){
+		mixed_radix_plan->execute(input.data(), output.data());
+		return;
+	}
+	#if FFT_FFTW_ENABLED
+	using fftw_complex_t = typename FFTW<T>::complex_t;
+	_ensure_plan_alignment(input.data(), output.data());
+	FFTW<T>::execute_dft(
+		plan.get(), 
+		reinterpret_cast<fftw_complex_t*>(const_cast<complex*>(input.data())), 
+		reinterpret_cast<fftw_complex_t*>(output.data())
+	);
+	#endif
+}
 
+template<class T>
+void FourierTransformer<T>::execute(std::span<const T> input, std::span<complex> output){
+	assert(real_transform && !inverse);
+	assert((input.size() == n_batch*size) && (output.size() == n_batch*spectrum_size));
+	if (backend == FFTBackend::MIXED_RADIX){
+		mixed_radix_plan->execute(input.data(), output.data());
+		return;
+	}
+	#if FFT_FFTW_ENABLED
+	using fftw_complex_t = typename FFTW<T>::complex_t;
+	_ensure_plan_alignment(input.data(), output.data());
+	// out-of-place real-to-complex transforms do not modify their input
+	FFTW<T>::execute_dft_r2c(
+		plan.get(), 
+		const_cast<T*>(input.data()), 
+		reinterpret_cast<fftw_complex_t*>(output.data())
+	);
+	#endif
+}
+
+template<class T>
+void FourierTransformer<T>::execute(std::span<complex> input, std::span<T> output){
+	assert(real_transform && inverse);
+	assert((input.size() == n_batch*spectrum_size) && (output.size() == n_batch*size));
+	if (backend == FFTBackend::MIXED_RADIX){
+		mixed_radix_plan->execute(input.data(), output.data());
+		return;
+	}
+	#if FFT_FFTW_ENABLED
+	using fftw_complex_t = typename FFTW<T>::complex_t;
+	_ensure_plan_alignment(input.data(), output.data());
+	FFTW<T>::execute_dft_c2r(
+		plan.get(), 
+		reinterpret_cast<fftw_complex_t*>(input.data()), 
+		output.data()
+	);
+	#endif
+}
+
+template<class T>
+void FourierTransformer<T>::convolve(std::span<const complex> spectrum, std::span<const complex> kernel_fft, std::span<T> output){
+	assert(real_transform && inverse);
+	assert(spectrum.size() == n_batch*spectrum_size);
+	assert((kernel_fft.size() == spectrum_size) || (kernel_fft.size() == n_batch*spectrum_size));
+	_allocate_buffers();
+
+	// Spell out the complex product, std::complex's operator* checks for NANs and
+	// does not vectorise.
+	const size_t kernel_stride = (kernel_fft.size() == spectrum_size) ? 0 : spectrum_size;
+	for(size_t k=0; k<n_batch; ++k){
+		const complex* a = spectrum.data() + k*spectrum_size;
+		const complex* b = kernel_fft.data() + k*kernel_stride;
+		complex* r = in.data() + k*spectrum_size;
+		for(size_t i=0; i<spectrum_size; ++i){
+			const T ar = a[i].real(), ai = a[i].imag();
+			const T br = b[i].real(), bi = b[i].imag();
+			r[i] = complex(ar*br - ai*bi, ar*bi + ai*br);
+		}
+	}
+
+	execute(in, output);
+}
+
+template<class T>
+void FourierTransformer<T>::convolve(std::span<const complex> spectrum, std::span<const T> kernel_fft, std::span<T> output){
+	assert(real_transform && inverse);
+	assert(spectrum.size() == n_batch*spectrum_size);
+	assert((kernel_fft.size() == spectrum_size) || (kernel_fft.size() == n_batch*spectrum_size));
+	_allocate_buffers();
+
+	const size_t kernel_stride = (kernel_fft.size() == spectrum_size) ? 0 : spectrum_size;
+	for(size_t k=0; k<n_batch; ++k){
+		const complex* a = spectrum.data() + k*spectrum_size;
+		const T* b = kernel_fft.data() + k*kernel_stride;
+		complex* r = in.data() + k*spectrum_size;
+		for(size_t i=0; i<spectrum_size; ++i){
+			r[i] = complex(a[i].real()*b[i], a[i].imag()*b[i]);
+		}
+	}
+
+	execute(in, output);
+}
+
+template<class T>
+void FourierTransformer<T>::normalise_spectrum(std::span<complex> spectrum) const {
+	const T factor = static_cast<T>(1.0/size);
+	for(complex& item : spectrum){
+		item *= factor;
+	}
+}
 
+template class FourierTransformer<double>;
+template class FourierTransformer<float>;
@@ -2,62 +2,369 @@
 #define __FFT_INCLUDED__
 
 #include <vector>
-#include <fftw3.h>
+#include <map>
+#include <string>
+#include <span>
+#include <memory>
+#include <type_traits>
 #include <complex>
 #include <cmath>
+#include <mutex>
+#include <thread>
 #include "data_utils.hpp"
 #include "logging.h"
 
 namespace du = data_utils;
 
+// Multithreaded transforms need FFTW built with '--enable-threads' and linking with
+// '-lfftw3_threads' (and '-pthread' for wasm), see the makefile's FFT_THREADS option.
+#ifndef FFT_THREADS_ENABLED
+	#define FFT_THREADS_ENABLED false
+#endif
+
+// FFTW can be left out for a smaller binary, see the makefile's FFT_FFTW option, then
+// every transform uses 'MixedRadixFFT'.
+#ifndef FFT_FFTW_ENABLED
+	#define FFT_FFTW_ENABLED true
+#endif
+
+#if FFT_FFTW_ENABLED
+	#include <fftw3.h>
+#endif
+#include "mixed_radix_fft.hpp"
+
+// How much effort FFTW spends finding a fast plan, in increasing order. Plans are
+// cached (see FFTPlanCache) so the expensive rigors are only paid for once per shape.
+enum class PlanRigor{
+	ESTIMATE,
+	MEASURE,
+	PATIENT,
+	EXHAUSTIVE
+};
+
+#if FFT_FFTW_ENABLED
+unsigned plan_rigor_flags(const PlanRigor rigor);
+#endif
+PlanRigor plan_rigor_from_string(const std::string& name);
+
+// Which library performs transforms. AUTO times both the first time a transform of a
+// given shape is set up and uses the faster one from then on, shapes with prime factors
+// above 'MixedRadixFFT::max_fast_radix' always use FFTW.
+enum class FFTBackend{
+	FFTW,
+	MIXED_RADIX,
+	AUTO
+};
+
+FFTBackend fft_backend_from_string(const std::string& name);
+std::string fft_backend_name(const FFTBackend backend);
+
+// Process-wide backend used by transformers set up after the call, AUTO by default.
+// Always MIXED_RADIX when FFT_FFTW_ENABLED is false.
+void set_fft_backend(const FFTBackend backend);
+FFTBackend get_fft_backend();
+
+// Smallest size >= 'n' with no prime factors above 7, FFTW is fastest for these.
+size_t next_fast_fft_size(size_t n);
+
+// Number of threads a transform will actually use when asked for 'n_threads'.
+// Zero means one per core, always 1 when FFT_THREADS_ENABLED is false.
+int fft_n_threads(size_t n_threads);
+
+
+// Name of each precision transforms can be done in
+template<class T>
+struct FFTPrecision;
+
+template<>
+struct FFTPrecision<double>{
+	static constexpr char name[] = "double";
+};
+
+template<>
+struct FFTPrecision<float>{
+	static constexpr char name[] = "float";
+};
+
+
+#if FFT_FFTW_ENABLED
+// The parts of FFTW's API that differ between precisions, 'fftw_*' for double and
+// 'fftwf_*' for float, so transformers can be written once for both.
+template<class T>
+struct FFTW;
+
+template<>
+struct FFTW<double>{
+	using complex_t = fftw_complex;
+	using plan_t = fftw_plan;
+
+	static constexpr auto malloc = fftw_malloc;
+	static constexpr auto free = fftw_free;
+	static constexpr auto alignment_of = fftw_alignment_of;
+	static constexpr auto plan_dft = fftw_plan_dft;
+	static constexpr auto plan_dft_r2c = fftw_plan_dft_r2c;
+	static constexpr auto plan_dft_c2r = fftw_plan_dft_c2r;
+	static constexpr auto plan_many_dft = fftw_plan_many_dft;
+	static constexpr auto plan_many_dft_r2c = fftw_plan_many_dft_r2c;
+	static constexpr auto plan_many_dft_c2r = fftw_plan_many_dft_c2r;
+	static constexpr auto execute_dft = fftw_execute_dft;
+	static constexpr auto execute_dft_r2c = fftw_execute_dft_r2c;
+	static constexpr auto execute_dft_c2r = fftw_execute_dft_c2r;
+	static constexpr auto destroy_plan = fftw_destroy_plan;
+	static constexpr auto import_wisdom_from_string = fftw_import_wisdom_from_string;
+	static constexpr auto export_wisdom_to_string = fftw_export_wisdom_to_string;
+	static constexpr auto import_wisdom_from_filename = fftw_import_wisdom_from_filename;
+	static constexpr auto export_wisdom_to_filename = fftw_export_wisdom_to_filename;
+	#if FFT_THREADS_ENABLED
+		static constexpr auto init_threads = fftw_init_threads;
+		static constexpr auto plan_with_nthreads = fftw_plan_with_nthreads;
+	#endif
+};
+
+template<>
+struct FFTW<float>{
+	using complex_t = fftwf_complex;
+	using plan_t = fftwf_plan;
+
+	static constexpr auto malloc = fftwf_malloc;
+	static constexpr auto free = fftwf_free;
+	static constexpr auto alignment_of = fftwf_alignment_of;
+	static constexpr auto plan_dft = fftwf_plan_dft;
+	static constexpr auto plan_dft_r2c = fftwf_plan_dft_r2c;
+	static constexpr auto plan_dft_c2r = fftwf_plan_dft_c2r;
+	static constexpr auto plan_many_dft = fftwf_plan_many_dft;
+	static constexpr auto plan_many_dft_r2c = fftwf_plan_many_dft_r2c;
+	static constexpr auto plan_many_dft_c2r = fftwf_plan_many_dft_c2r;
+	static constexpr auto execute_dft = fftwf_execute_dft;
+	static constexpr auto execute_dft_r2c = fftwf_execute_dft_r2c;
+	static constexpr auto execute_dft_c2r = fftwf_execute_dft_c2r;
+	static constexpr auto destroy_plan = fftwf_destroy_plan;
+	static constexpr auto import_wisdom_from_string = fftwf_import_wisdom_from_string;
+	static constexpr auto export_wisdom_to_string = fftwf_export_wisdom_to_string;
+	static constexpr auto import_wisdom_from_filename = fftwf_import_wisdom_from_filename;
+	static constexpr auto export_wisdom_to_filename = fftwf_export_wisdom_to_filename;
+	#if FFT_THREADS_ENABLED
+		static constexpr auto init_threads = fftwf_init_threads;
+		static constexpr auto plan_with_nthreads = fftwf_plan_with_nthreads;
+	#endif
+};
+#endif
+
+
+// Process-wide store of FFTW plans. Plans are shared with the transformers that use
+// them, so 'clear()' only drops the cache's references and a plan is destroyed once
+// no transformer holds it either. Plans are made on scratch arrays and executed via the
+// new-array interface (fftw_execute_dft etc.), so one plan can be used on any buffers
+// with the same alignment as the scratch arrays. Therefore alignment is part of the key,
+// and planning never overwrites the data a plan will be used on.
+// All functions are thread-safe, FFTW's planner is not so planning is serialised.
+// Double and float plans (and wisdom) are kept separately, as FFTW does.
+// Without FFTW there are no plans or wisdom, importing and exporting wisdom fails.
+namespace FFTPlanCache{
+	struct PlanKey{
+		std::vector<size_t> shape; // FFTW order, slowest varying axis first
+		bool inverse;
+		bool real_transform;
+		PlanRigor rigor;
+		int in_alignment;
+		int out_alignment;
+		int n_threads;
+		int n_batch; // transforms per execution, laid out one after another
+
+		auto operator<=>(const PlanKey&) const = default;
+	};
+
+	#if FFT_FFTW_ENABLED
+	// FFTW plan that calls 'FFTW<T>::destroy_plan' when the last reference goes
+	template<class T=double>
+	using Plan = std::shared_ptr<std::remove_pointer_t<typename FFTW<T>::plan_t>>;
+
+	// Returns a cached plan that is at least as rigorous as 'key.rigor', creates
+	// one if there is no such plan. Null when FFTW could not make the plan.
+	template<class T=double>
+	Plan<T> get(const PlanKey& key);
+	#endif
+
+	// Number of plans of both precisions
+	size_t size();
+
+	// Empties the cache, plans still used by transformers stay valid until they are released.
+	void clear();
+
+	// Wisdom lets plans found in a previous session be re-created without
+	// re-measuring. Strings are in FFTW's wisdom format, e.g., as stored by JS.
+	template<class T=double>
+	bool import_wisdom(const std::string& wisdom);
+	template<class T=double>
+	std::string export_wisdom();
+	template<class T=double>
+	bool import_wisdom_from_file(const std::string& path);
+	template<class T=double>
+	bool export_wisdom_to_file(const std::string& path);
+}
+
+
+// 'T' is the precision of the transform, double or float. Transforms are done by FFTW
+// or 'MixedRadixFFT', see 'FFTBackend', both give the same (unnormalised) results.
+template<class T=double>
 class FourierTransformer{
 	public:
-	using complex=std::complex<double>;
-	
+	using real=T;
+	using complex=std::complex<T>;
+
+	// When 'real_transform' is true, the transform is real-to-complex (forward) or
+	// complex-to-real (inverse). Real-space data lives in 'real_buffer', and only the
+	// non-redundant half of the spectrum is stored, i.e., the fastest varying axis of
+	// the spectrum has length (n/2+1). Otherwise both 'in' and 'out' are full complex
+	// arrays. These buffers are only allocated when 'operator()' or 'real_output()'
+	// are used, 'execute()' works on the caller's buffers instead.
+	//
+	// When 'n_batch' > 1 each execution transforms 'n_batch' arrays of 'shape' stored
+	// one after another, e.g., the planar RRR...GGG...BBB... layers of an 'Image', with
+	// one FFTW call. 'size' and 'spectrum_size' are still those of ONE array, buffers
+	// and spans hold 'n_batch' times as many elements.
 	std::vector<complex> in, out;
+	std::vector<T> real_buffer;
 	std::vector<size_t> shape;
+	std::vector<size_t> spectrum_shape;
 	size_t size;
+	size_t spectrum_size;
 	bool inverse;
-	bool plan_measure;
-	fftw_plan plan;
+	PlanRigor plan_rigor;
+	bool real_transform;
+	size_t n_threads; // see 'fft_n_threads()'
+	size_t n_batch;
+	FFTBackend backend; // FFTW or MIXED_RADIX once set up, see 'set_fft_backend()'
+	FFTPlanCache::PlanKey plan_key;
+	#if FFT_FFTW_ENABLED
+	FFTPlanCache::Plan<T> plan; // shared with FFTPlanCache
+	#endif
+	std::shared_ptr<const MixedRadixFFT<T>> mixed_radix_plan;
 
 	FourierTransformer(
 			const std::vector<size_t>& _shape = {},
 			const bool _inverse = false,
-			const bool _plan_measure = false
+			const PlanRigor _plan_rigor = PlanRigor::ESTIMATE,
+			const bool _real_transform = false,
+			const size_t _n_threads = 1,
+			const size_t _n_batch = 1
 		);
-	
+
 	void set_attrs(
 		const std::vector<size_t>& _shape,
 		const bool _inverse = false,
-		const bool _plan_measure = false
+		const PlanRigor _plan_rigor = PlanRigor::ESTIMATE,
+		const bool _real_transform = false,
+		const size_t _n_threads = 1,
+		const size_t _n_batch = 1
 	);
-	
+
 	void get_plan();
 
+	// Makes the plan for 'backend'
+	void _prepare_backend();
+
+	// Times one transform with each backend and returns the faster, the choice is
+	// remembered for transforms with the same 'plan_key'.
+	FFTBackend _calibrate_backend();
+
+	// Swaps to a plan matching the alignment of 'in_ptr' and 'out_ptr' if the current
+	// plan does not, e.g., after this transformer has been copied.
+	void _ensure_plan_alignment(const void* in_ptr, const void* out_ptr);
+
+	// Runs the plan on this transformer's own buffers
+	void execute();
+
+	// Runs the plan directly from 'input' into 'output', no copies are made and the
+	// result is NOT normalised, i.e., forward followed by inverse multiplies by 'size'.
+	// Real spans have 'n_batch*size' elements and complex spans 'n_batch*spectrum_size' elements.
+	// Spans can have any alignment, but a new plan is needed for each alignment.
+	void execute(std::span<const complex> input, std::span<complex> output);
+	void execute(std::span<const T> input, std::span<complex> output);
+	// NOTE: complex-to-real transforms overwrite 'input'
+	void execute(std::span<complex> input, std::span<T> output);
+
+	// Circular convolution for inverse real transformers. Multiplies 'spectrum' by
+	// 'kernel_fft' in one pass into this transformer's input buffer, then transforms
+	// from there straight into 'output'. 'spectrum' is not modified. No normalisation
+	// is applied, so fold 1/size into 'kernel_fft' beforehand (see 'normalise_spectrum()').
+	// For batched transformers 'kernel_fft' is either one spectrum used for every array
+	// of the batch, or one spectrum per array.
+	void convolve(std::span<const complex> spectrum, std::span<const complex> kernel_fft, std::span<T> output);
+	// As above for a real 'kernel_fft', i.e., the spectrum of a kernel that is symmetric
+	// under point reflection through pixel 0. Needs half the storage, and the product
+	// half the multiplications, of a complex one.
+	void convolve(std::span<const complex> spectrum, std::span<const T> kernel_fft, std::span<T> output);
+
+	// Folds the 1/size normalisation of the inverse transform into 'spectrum'
+	void normalise_spectrum(std::span<complex> spectrum) const;
 
-	template <class T>
-	std::vector<complex>& operator()(const std::vector<T>& input_data){
-		assert(input_data.size() == size);
+	void _allocate_buffers();
 
-		if constexpr(std::is_same<complex, T>::value) {
+	// Copies 'input_data' into the input buffer of the transform
+	template <class U>
+	void _set_input(const std::vector<U>& input_data){
+		_allocate_buffers();
+
+		if (real_transform && !inverse){
+			assert(input_data.size() == n_batch*size);
+			if constexpr(du::is_template_specialisation<U, std::complex>{}){
+				du::copy_from_real(input_data, real_buffer);
+			} else {
+				du::copy_to(input_data, real_buffer);
+			}
+			return;
+		}
+
+		assert(input_data.size() == n_batch*spectrum_size);
+
+		if constexpr(std::is_same<complex, U>::value) {
 			in = input_data;
 		}
-		else if constexpr(du::is_template_specialisation<T, std::complex>{}){
+		else if constexpr(du::is_template_specialisation<U, std::complex>{}){
 			du::copy_to(input_data, in);
 		} else {
 			// Assume input data is real
 			du::copy_as_real(input_data, in);
 		}
+	}
+
+	// Returns the (complex) result of the transform. Not available for
+	// complex-to-real transforms, use 'real_output()' for those.
+	template <class U>
+	std::vector<complex>& operator()(const std::vector<U>& input_data){
+		assert(!(real_transform && inverse));
+
+		_set_input(input_data);
 
-		fftw_execute(plan);
+		execute();
 
 		if (inverse){
-			du::multiply_inplace(out, 1.0/size);
+			du::multiply_inplace(out, static_cast<T>(1.0/size));
 		}
 
 		return(out);
 	}
+
+	// Returns the real part of the result of the transform. For complex-to-real
+	// transforms this is the whole result.
+	template <class U>
+	std::vector<T>& real_output(const std::vector<U>& input_data){
+		if (!real_transform){
+			real_buffer.resize(n_batch*size);
+			du::copy_from_real((*this)(input_data), real_buffer);
+			return(real_buffer);
+		}
+		assert(inverse);
+
+		_set_input(input_data);
+
+		execute();
+
+		du::multiply_inplace(real_buffer, static_cast<T>(1.0/size));
+
+		return(real_buffer);
+	}
 };
 
 #endif //__FFT_INCLUDED__
@@ -62,7 +62,7 @@ std::span<R> image_as_blob(
 			size_t j=0;
 			for (size_t i=0; i< a.size(); ++i){
 				j = 4*i;
-				image_data[j] = (std::byte)(round_to<uint8_t>(stretch_range(a[i], min, max, 0.0, 255.0)));
+				image_data[j] = (std::byte)(round_to<uint8_t>(stretch_range<double>(a[i], min, max, 0.0, 255.0)));
 
 				image_data[j+1] = image_data[j];
 				image_data[j+2] = image_data[j];
@@ -84,7 +84,7 @@ std::span<R> image_as_blob(
 					//	LOGV_DEBUG(layer_stride*k + i);
 					//	LOGV_DEBUG(a[layer_stride*k + i]);
 					//}
-					image_data[4*i+k] = (std::byte)(round_to<uint8_t>(stretch_range(a[layer_stride*k + i], min, max, 0.0, 255.0)));
+					image_data[4*i+k] = (std::byte)(round_to<uint8_t>(stretch_range<double>(a[layer_stride*k + i], min, max, 0.0, 255.0)));
 				}
 			}
 			for (size_t i=0; i < layer_stride; ++i){
@@ -100,7 +100,7 @@ std::span<R> image_as_blob(
 			for (size_t i=0; i < a.size(); ++i){
 				j = (i%4)*a.size()/4;
 				k = i%(a.size()/4);
-				image_data[i] = (std::byte)(round_to<uint8_t>(stretch_range(a[j+k], min, max, 0.0, 255.0)));
+				image_data[i] = (std::byte)(round_to<uint8_t>(stretch_range<double>(a[j+k], min, max, 0.0, 255.0)));
 			}
 			break;
 		}
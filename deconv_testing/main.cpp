@@ -120,20 +120,61 @@ void DUMMY_load_data(std::string fname, std::vector<double>& img_data, std::vect
 
 
 
-std::vector<std::string> deconv_types = {"clean_modified"};
-std::map<std::string, CleanModifiedAlgorithm> clean_modified_deconvolvers;
+std::vector<std::string> deconv_types = {"clean_modified", "hogbom", "clark", "multiscale", "richardson_lucy", "fista"};
+std::map<std::string, std::unique_ptr<Deconvolver>> deconvolvers;
 std::string current_deconv_type = "";
 std::string current_deconv_name = "";
+// Names of deconvolvers whose tasks 'run_deconvolver()' is part way through, tasks yield to
+// the event loop so these must not be replaced until it returns
+std::set<std::string> deconvolvers_running_tasks;
 
 
+// Get deconvolver 'deconv_name' as the type 'D' its parameters are set on,
+// e.g., 'CleanModifiedAlgorithmBase' covers both precisions of 'CleanModifiedAlgorithm'.
+template<class D=Deconvolver>
+D& get_deconvolver(const std::string& deconv_name){
+	return dynamic_cast<D&>(*deconvolvers.at(deconv_name));
+}
+
 
-int create_deconvolver(const std::string& deconv_type, const std::string& deconv_name){//, int max_n_iters){
+// Makes a deconvolver of 'deconv_type' computing in precision 'T'
+template<class T>
+std::unique_ptr<Deconvolver> make_deconvolver(const std::string& deconv_type, bool batch_channels){
+	if (deconv_type == "hogbom"){
+		return std::make_unique<HogbomCleanAlgorithm<T>>();
+	}
+	if (deconv_type == "clark"){
+		return std::make_unique<ClarkCleanAlgorithm<T>>();
+	}
+	if (deconv_type == "multiscale"){
+		return std::make_unique<MultiScaleCleanAlgorithm<T>>();
+	}
+	if (deconv_type == "richardson_lucy"){
+		return std::make_unique<RichardsonLucyAlgorithm<T>>();
+	}
+	if (deconv_type == "fista"){
+		return std::make_unique<FistaAlgorithm<T>>();
+	}
+	// Batched deconvolvers handle all colour channels of an image together.
+	if (batch_channels){
+		return std::make_unique<BatchedCleanModifiedAlgorithm<T>>();
+	}
+	return std::make_unique<CleanModifiedAlgorithm<T>>();
+}
+
+
+int create_deconvolver(
+		const std::string& deconv_type, 
+		const std::string& deconv_name, 
+		const std::string& precision="double",
+		bool batch_channels=false
+	){//, int max_n_iters){
 	GET_LOGGER;
 
 	// Ensure we have good arguments
 	if(! du::contains(deconv_types, deconv_type)){
 		LOG_MSG_START("Passed '%' as argument deconv_type. Must be one of the following {");
-		for(auto& item : deconv_type){
+		for(auto& item : deconv_types){
 			LOG_MSG_CONT("%, ", item);
 		}
 		LOG_MSG_CONT("}");
@@ -141,72 +182,114 @@ int create_deconvolver(const std::string& deconv_type, const std::string& deconv
 		return -1;
 	}
 
-	// remove previous deconvolver
+	// A running deconvolver is suspended in 'emscripten_sleep()', it must outlive its run
+	if (deconvolvers_running_tasks.contains(deconv_name) || (deconvolvers.contains(deconv_name) && deconvolvers.at(deconv_name)->running)){
+		LOG_ERROR("Deconvolver '%' is running, it cannot be replaced until the run finishes or is paused", deconv_name);
+		return -1;
+	}
+
+	// remove previous deconvolver, and the tasks bound to it that a pause left to run
 	if (current_deconv_name.size() != 0){
-		clean_modified_deconvolvers.erase(deconv_name);
+		deconvolvers.erase(deconv_name);
 	}
+	Storage::deconv_task_buffers.erase(deconv_name);
 
 	// initialise deconvolver, choose based on 'deconv_type'
 	
 	current_deconv_type = deconv_type;
 	current_deconv_name = deconv_name;
 
-	// Only have one deconvolver type for now, so use that one
-	clean_modified_deconvolvers[deconv_name] = CleanModifiedAlgorithm();
+	if (batch_channels && (deconv_type != "clean_modified")){
+		LOG_WARN("Only 'clean_modified' deconvolvers can batch channels, '%' will deconvolve them one at a time.", deconv_type);
+		batch_channels = false;
+	}
+	if (precision == "float"){
+		deconvolvers[deconv_name] = make_deconvolver<float>(deconv_type, batch_channels);
+	} else {
+		if (precision != "double"){
+			LOG_WARN("Unknown precision '%', should be one of {double, float}. Using 'double'.", precision);
+		}
+		deconvolvers[deconv_name] = make_deconvolver<double>(deconv_type, batch_channels);
+	}
 	
 	emscripten_sleep(1); // pass control back to javascript to allow event loop to run
 	return 0;
 }
 
 
+// Name of the image holding the clean map restored with the k^th extra clean beam
+std::string extra_clean_map_name(const std::string& deconv_name, size_t k){
+	return deconv_name + "_clean_map_beam_" + std::to_string(k);
+}
+
 void copy_deconv_results_to_layer(
 		const std::string& deconv_type,
 		const std::string& deconv_name,
 		int layer_idx
 	){
-	CleanModifiedAlgorithm& deconv = clean_modified_deconvolvers[deconv_name];
+	const Deconvolver& deconv = get_deconvolver(deconv_name);
 	std::vector<size_t> raw_data_shape = du::subtract(deconv.data_shape, deconv.data_shape_adjustment);
-	std::vector<double> raw_data(du::product(raw_data_shape));
 	
-	std::span<double> layer_span = Storage::images[deconv_name+"_clean_map"].get_span_of_layer(layer_idx);
-	std::vector<double> data = du::reshape(deconv.clean_map, deconv.data_shape, raw_data_shape); 
+	// Crop out the padding the deconvolver added to get FFT friendly sizes
+	auto crop_to_raw_shape = [&](const std::vector<double>& padded_data){
+		if (du::is_identical(deconv.data_shape, raw_data_shape)){
+			return padded_data;
+		}
+		return du::reshape(padded_data, deconv.data_shape, raw_data_shape);
+	};
 	
-	for(size_t i=0; i<data.size(); ++i){
-		layer_span[i] = data[i];
+	// Deconvolvers that handle all channels at once fill 'n_channels' layers from 'layer_idx'
+	const std::vector<double> clean_map = deconv.get_clean_map();
+	const std::vector<double> residual = deconv.get_residual();
+	for(size_t c=0; c<deconv.n_channels; ++c){
+		std::span<double> layer_span = Storage::images[deconv_name+"_clean_map"].get_span_of_layer(layer_idx+c);
+		std::vector<double> data = crop_to_raw_shape(std::vector<double>(clean_map.begin()+c*deconv.data_size, clean_map.begin()+(c+1)*deconv.data_size)); 
+		
+		for(size_t i=0; i<data.size(); ++i){
+			layer_span[i] = data[i];
+		}
+		
+		layer_span = Storage::images[deconv_name+"_residual"].get_span_of_layer(layer_idx+c);
+		data = crop_to_raw_shape(std::vector<double>(residual.begin()+c*deconv.data_size, residual.begin()+(c+1)*deconv.data_size)); 
+		for(size_t i=0; i<data.size(); ++i){
+			layer_span[i] = data[i];
+		}
 	}
-	
-	layer_span = Storage::images[deconv_name+"_residual"].get_span_of_layer(layer_idx);
-	data = du::reshape(deconv.residual_data, deconv.data_shape, raw_data_shape); 
-	for(size_t i=0; i<data.size(); ++i){
-		layer_span[i] = data[i];
+
+	// Extra clean maps are held in images shaped like the clean map, made when first needed
+	const Image& clean_map_image = Storage::images[deconv_name+"_clean_map"];
+	for(size_t k=0; k<deconv.n_extra_clean_maps(); ++k){
+		Image& extra_image = Storage::images.try_emplace(
+			extra_clean_map_name(deconv_name, k), 
+			clean_map_image.shape, 
+			clean_map_image.pxfmt
+		).first->second;
+		const std::vector<double> extra_clean_map = deconv.get_extra_clean_map(k);
+		for(size_t c=0; c<deconv.n_channels; ++c){
+			std::span<double> layer_span = extra_image.get_span_of_layer(layer_idx+c);
+			std::vector<double> data = crop_to_raw_shape(std::vector<double>(extra_clean_map.begin()+c*deconv.data_size, extra_clean_map.begin()+(c+1)*deconv.data_size)); 
+			for(size_t i=0; i<data.size(); ++i){
+				layer_span[i] = data[i];
+			}
+		}
 	}
 }
 
-emscripten::val prepare_deconvolver(
-		const std::string& deconv_type, 
-		const std::string& deconv_name, 
-		const std::string& sci_image_name, 
-		const std::string& psf_image_name, 
-		const std::string& run_tag=""
-	){
-	GET_LOGGER;
-	// get deconvolver
-	// Only one type for now, so use that
-	
-	CleanModifiedAlgorithm& deconvolver = clean_modified_deconvolvers[deconv_name];
-
-	Image& sci_image = Storage::images[sci_image_name];
-	Image& psf_image = Storage::images[psf_image_name];
-	
+// Empty when 'psf_image' can be used to deconvolve 'sci_image', otherwise the reason it cannot
+std::string check_psf_channels(const Image& sci_image, const Image& psf_image){
 	bool multi_channel_psf = psf_image.shape[2]>1;
 	
 	if ((sci_image.shape[2] != psf_image.shape[2]) && multi_channel_psf) {
-		return emscripten::val("PSF image must have the same number of colour channels as the Science image, OR have a single colour channel that will be used for all colour channels of the Science image. Cannot deconvolve.");
+		return "PSF image must have the same number of colour channels as the Science image, OR have a single colour channel that will be used for all colour channels of the Science image. Cannot deconvolve.";
 	}
-	
-	// Create holders for results of deconvolution
+	return "";
+}
+
+// (Re)creates the images holding the results of deconvolving 'sci_image'
+void create_deconv_result_images(const std::string& deconv_name, const Image& sci_image){
 	Storage::images.erase(deconv_name+"_clean_map");
 	Storage::images.erase(deconv_name+"_residual");
+	for(size_t k=0; Storage::images.erase(extra_clean_map_name(deconv_name, k)) > 0; ++k){}
 	Storage::images.emplace(
 		std::make_pair(
 			deconv_name+"_clean_map", 
@@ -226,8 +309,28 @@ emscripten::val prepare_deconvolver(
 			)
 		)
 	);
+}
+
+emscripten::val prepare_deconvolver(
+		const std::string& deconv_type, 
+		const std::string& deconv_name, 
+		const std::string& sci_image_name, 
+		const std::string& psf_image_name, 
+		const std::string& run_tag=""
+	){
+	GET_LOGGER;
+	Deconvolver& deconvolver = get_deconvolver(deconv_name);
+
+	Image& sci_image = Storage::images[sci_image_name];
+	Image& psf_image = Storage::images[psf_image_name];
 	
+	const std::string err_msg = check_psf_channels(sci_image, psf_image);
+	if (err_msg.size() > 0){
+		return emscripten::val(err_msg);
+	}
 	
+	// Create holders for results of deconvolution
+	create_deconv_result_images(deconv_name, sci_image);
 
 	std::list<std::function<void()>>& deconv_task_buffer = Storage::deconv_task_buffers[deconv_name];
 	
@@ -236,7 +339,44 @@ emscripten::val prepare_deconvolver(
 	
 	update_deconv_layer_status("starting...");
 	
+	if (deconvolver.handles_all_channels()){
+		// One set of tasks deconvolves every layer of the input image
+		deconv_task_buffer.push_back(
+			std::bind(
+				update_deconv_layer_status,
+				"all " + std::to_string(sci_image.shape[2])
+			)
+		);
+		deconv_task_buffer.push_back(
+			std::bind(
+				&Deconvolver::prepare_observations,
+				&deconvolver,
+				std::span<double>(sci_image.data),
+				std::span<size_t>(sci_image.shape),
+				std::span<double>(psf_image.data),
+				std::span<size_t>(psf_image.shape),
+				run_tag
+			)
+		);
+		deconv_task_buffer.push_back(
+			std::bind(
+				&Deconvolver::run,
+				&deconvolver
+			)
+		);
+		deconv_task_buffer.push_back(
+			std::bind(
+				copy_deconv_results_to_layer,
+				deconv_type,
+				deconv_name,
+				0
+			)
+		);
+		return emscripten::val("");
+	}
+	
 	// Create new tasks to deconvolve each layer of the input image
+	bool multi_channel_psf = psf_image.shape[2]>1;
 	for(int i=0; i<sci_image.shape[2]; ++i){
 		deconv_task_buffer.push_back(
 			std::bind(
@@ -246,7 +386,7 @@ emscripten::val prepare_deconvolver(
 		);
 		deconv_task_buffer.push_back(
 			std::bind(
-				&CleanModifiedAlgorithm::prepare_observations,
+				&Deconvolver::prepare_observations,
 				&deconvolver,
 				sci_image.get_span_of_layer(i),
 				sci_image.get_shape_of_layer(i),
@@ -257,7 +397,7 @@ emscripten::val prepare_deconvolver(
 		);
 		deconv_task_buffer.push_back(
 			std::bind(
-				&CleanModifiedAlgorithm::run,
+				&Deconvolver::run,
 				&deconvolver
 			)
 		);
@@ -284,18 +424,183 @@ emscripten::val prepare_deconvolver(
 	return emscripten::val("");
 }
 
+// Fills the deconvolver's clean map image with a quick preview instead of running it, see
+// 'Deconvolver::preview()'. Prepares only what the preview needs itself, so needs no call to
+// 'prepare_deconvolver()', and takes milliseconds rather than the time of a full run.
+emscripten::val preview_deconvolver(
+		const std::string& deconv_type, 
+		const std::string& deconv_name, 
+		const std::string& sci_image_name, 
+		const std::string& psf_image_name
+	){
+	GET_LOGGER;
+	Deconvolver& deconvolver = get_deconvolver(deconv_name);
+	if (deconvolver.running){
+		return emscripten::val("Deconvolver '" + deconv_name + "' is running, cannot preview until the run finishes or is paused.");
+	}
+
+	Image& sci_image = Storage::images[sci_image_name];
+	Image& psf_image = Storage::images[psf_image_name];
+	
+	const std::string err_msg = check_psf_channels(sci_image, psf_image);
+	if (err_msg.size() > 0){
+		return emscripten::val(err_msg);
+	}
+	
+	create_deconv_result_images(deconv_name, sci_image);
+
+	if (deconvolver.handles_all_channels()){
+		deconvolver.prepare_preview(
+			std::span<double>(sci_image.data),
+			std::span<size_t>(sci_image.shape),
+			std::span<double>(psf_image.data),
+			std::span<size_t>(psf_image.shape),
+			"preview_"
+		);
+		deconvolver.preview();
+		copy_deconv_results_to_layer(deconv_type, deconv_name, 0);
+		return emscripten::val("");
+	}
+
+	bool multi_channel_psf = psf_image.shape[2]>1;
+	for(int i=0; i<sci_image.shape[2]; ++i){
+		deconvolver.prepare_preview(
+			sci_image.get_span_of_layer(i),
+			sci_image.get_shape_of_layer(i),
+			psf_image.get_span_of_layer(i*multi_channel_psf),
+			psf_image.get_shape_of_layer(i*multi_channel_psf),
+			"preview_"
+		);
+		deconvolver.preview();
+		copy_deconv_results_to_layer(deconv_type, deconv_name, i);
+	}
+	return emscripten::val("");
+}
+
+// Stops a 'run_deconvolver()' in progress once its current iteration is done, so a checkpoint
+// can be saved. 'run_deconvolver()' continues it.
+void pause_deconvolver(
+		const std::string& deconv_type,
+		const std::string& deconv_name
+	){
+	GET_LOGGER;
+	Deconvolver& deconvolver = get_deconvolver(deconv_name);
+	if (!deconvolver.running){
+		LOG_WARN("Deconvolver '%' is not running, there is nothing to pause", deconv_name);
+		return;
+	}
+	deconvolver.pause();
+}
+
+// Name of the blob holding the last checkpoint of deconvolver 'deconv_name' saved or resumed from
+std::string checkpoint_blob_name(const std::string& deconv_name){
+	return deconv_name + "_checkpoint";
+}
+
+// Bytes of a checkpoint of the deconvolver's state, see 'Deconvolver::save_checkpoint()'.
+// Save them after 'run_deconvolver()' returns, or is paused, to continue the run later with
+// 'prepare_deconvolver_from_checkpoint()'. Null when the deconvolver cannot save checkpoints
+// or is running.
+emscripten::val get_deconvolver_checkpoint(
+		const std::string& deconv_type,
+		const std::string& deconv_name
+	){
+	GET_LOGGER;
+	const Deconvolver& deconvolver = get_deconvolver(deconv_name);
+	if (!deconvolver.supports_checkpoints()){
+		LOG_WARN("'%' deconvolvers cannot save checkpoints", deconv_type);
+		return emscripten::val::null();
+	}
+	std::vector<std::byte>& checkpoint = Storage::named_blobs[checkpoint_blob_name(deconv_name)];
+	checkpoint = deconvolver.save_checkpoint();
+	if (checkpoint.empty()){
+		return emscripten::val::null();
+	}
+	return emscripten::val(emscripten::typed_memory_view(checkpoint.size(), reinterpret_cast<uint8_t*>(checkpoint.data())));
+}
+
+// As 'prepare_deconvolver()', but the deconvolver continues the run 'checkpoint_array' (bytes
+// from 'get_deconvolver_checkpoint()') was saved from instead of preparing observations. The
+// deconvolver must be of the type and precision that saved it, and takes the parameters of
+// the run from it except 'n_iter' and those of the clean beams. The results are written to
+// layer 'layer_idx' of images shaped like the science image, the checkpoint holds one layer.
+emscripten::val prepare_deconvolver_from_checkpoint(
+		const std::string& deconv_type, 
+		const std::string& deconv_name, 
+		const std::string& sci_image_name, 
+		const emscripten::val& checkpoint_array,
+		int layer_idx
+	){
+	GET_LOGGER;
+	Deconvolver& deconvolver = get_deconvolver(deconv_name);
+	if (!deconvolver.supports_checkpoints()){
+		return emscripten::val("'" + deconv_type + "' deconvolvers cannot resume from checkpoints.");
+	}
+
+	const std::vector<uint8_t> checkpoint_bytes = emscripten::convertJSArrayToNumberVector<uint8_t>(checkpoint_array);
+	std::vector<std::byte>& checkpoint = Storage::named_blobs[checkpoint_blob_name(deconv_name)];
+	checkpoint.resize(checkpoint_bytes.size());
+	std::memcpy(checkpoint.data(), checkpoint_bytes.data(), checkpoint_bytes.size());
+	if (!deconvolver.resume_from_checkpoint(checkpoint)){
+		return emscripten::val("Could not resume from checkpoint, see log for details.");
+	}
+
+	const Image& sci_image = Storage::images[sci_image_name];
+	const std::vector<size_t> raw_data_shape = du::subtract(deconvolver.data_shape, deconvolver.data_shape_adjustment);
+	if ((raw_data_shape[0] != sci_image.shape[0]) || (raw_data_shape[1] != sci_image.shape[1])){
+		return emscripten::val("Checkpoint was not saved from a deconvolution of an image the shape of the Science image.");
+	}
+	if ((layer_idx < 0) || (layer_idx >= static_cast<int>(sci_image.shape[2]))){
+		return emscripten::val("Science image has no layer " + std::to_string(layer_idx) + " to write results to.");
+	}
+	create_deconv_result_images(deconv_name, sci_image);
+
+	std::list<std::function<void()>>& deconv_task_buffer = Storage::deconv_task_buffers[deconv_name];
+	deconv_task_buffer.clear();
+	deconv_task_buffer.push_back(
+		std::bind(
+			update_deconv_layer_status,
+			std::to_string(layer_idx+1) + "/" + std::to_string(sci_image.shape[2]) + " (resumed)"
+		)
+	);
+	deconv_task_buffer.push_back(
+		std::bind(
+			&Deconvolver::run,
+			&deconvolver
+		)
+	);
+	deconv_task_buffer.push_back(
+		std::bind(
+			copy_deconv_results_to_layer,
+			deconv_type,
+			deconv_name,
+			layer_idx
+		)
+	);
+	return emscripten::val("");
+}
+
+// Tasks are removed as they finish. When 'pause_deconvolver()' stops a run its task is kept,
+// so calling this again continues the run and the tasks after it.
 void run_deconvolver(
 		const std::string& deconv_type, 
 		const std::string& deconv_name
 	){
 	GET_LOGGER;
-	// get deconvolver
-	// Only one type for now, so use that
-	
-	std::list<std::function<void()>> deconv_task_buffer = Storage::deconv_task_buffers[deconv_name];
-	for(auto& task : deconv_task_buffer){
-		task();
+	Deconvolver& deconvolver = get_deconvolver(deconv_name);
+	std::list<std::function<void()>>& deconv_task_buffer = Storage::deconv_task_buffers[deconv_name];
+	// Only a run task started by this call can be paused
+	deconvolver.paused = false;
+	deconvolvers_running_tasks.insert(deconv_name);
+	while(!deconv_task_buffer.empty()){
+		deconv_task_buffer.front()();
+		if (deconvolver.paused){
+			update_deconv_layer_status("paused");
+			break;
+		}
+		deconv_task_buffer.pop_front();
 	}
+	deconvolvers_running_tasks.erase(deconv_name);
 	
 	//CleanModifiedAlgorithm& deconvolver = clean_modified_deconvolvers[deconv_name];
 	//deconvolver.run();
@@ -319,6 +624,21 @@ emscripten::val get_deconvolver_clean_map(
 	return image_as_JSImageData(deconv_name+"_clean_map");
 }
 
+// 'k' indexes the deconvolver's extra clean beams, see 'set_deconvolver_extra_clean_beams()'
+emscripten::val get_deconvolver_extra_clean_map(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		size_t k
+	){
+	GET_LOGGER;
+	LOG_DEBUG("Sending clean map of extra clean beam %", k);
+	if (Storage::images.count(extra_clean_map_name(deconv_name, k)) == 0){
+		LOG_WARN("Deconvolver '%' has no clean map for extra clean beam %", deconv_name, k);
+		return emscripten::val::null();
+	}
+	return image_as_JSImageData(extra_clean_map_name(deconv_name, k));
+}
+
 emscripten::val get_deconvolver_residual(
 		const std::string& deconv_type,
 		const std::string& deconv_name
@@ -435,7 +755,7 @@ void set_deconvolver_parameters(
 		double _fabs_frac_threshold,
 		size_t _plot_update_interval
 	){
-	CleanModifiedAlgorithm& deconvolver = clean_modified_deconvolvers[deconv_name];
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
 	
 	deconvolver.n_iter= _n_iter;
 	deconvolver.n_positive_iter = _n_positive_iter;
@@ -458,6 +778,184 @@ void set_deconvolver_parameters(
 	deconvolver.threshold_record.resize(_n_iter, NAN); 
 }
 
+// 'sigmas' is a JS array of clean beam standard deviations (in pixels), restored as well
+// as the one given to 'set_deconvolver_parameters()'. An empty array removes them.
+void set_deconvolver_extra_clean_beams(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		const emscripten::val& sigmas
+	){
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
+	deconvolver.extra_clean_beam_sigmas = emscripten::vecFromJSArray<double>(sigmas);
+}
+
+void set_deconvolver_fft_plan_rigor(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		const std::string& plan_rigor_name
+	){
+	Deconvolver& deconvolver = get_deconvolver(deconv_name);
+	deconvolver.fft_plan_rigor = plan_rigor_from_string(plan_rigor_name);
+}
+
+void set_deconvolver_update_mode(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		const std::string& update_mode,
+		double psf_support_threshold,
+		size_t fft_tile_size
+	){
+	GET_LOGGER;
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
+	if ((update_mode != "fft") && (update_mode != "direct") && (update_mode != "hybrid") && (update_mode != "tiled") && (update_mode != "separable")){
+		LOG_WARN("Unknown update mode '%', should be one of {fft, direct, hybrid, tiled, separable}. Using 'hybrid'.", update_mode);
+		deconvolver.update_mode = "hybrid";
+	} else {
+		deconvolver.update_mode = update_mode;
+	}
+	deconvolver.psf_support_threshold = psf_support_threshold;
+	deconvolver.fft_tile_size = fft_tile_size;
+}
+
+// Largest relative error of the separable PSF approximation used by the "separable" update mode
+void set_deconvolver_separable_psf_error(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		double max_relative_error
+	){
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
+	deconvolver.separable_psf_error = max_relative_error;
+}
+
+// PSFs within 'tolerance' (a fraction of their maximum) of being symmetric under point
+// reflection use a real spectrum, negative turns this off
+void set_deconvolver_psf_symmetry_tolerance(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		double tolerance
+	){
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
+	deconvolver.psf_symmetry_tolerance = tolerance;
+}
+
+// Minor cycles of "clark" deconvolvers subtract the PSF pixels above 'psf_patch_threshold'
+// times its maximum, and do at most 'max_minor_iter' (at least one) subtractions per major cycle. With
+// 'stop_on_rms_increase' iterations stop when a major cycle increases the residual's RMS.
+void set_deconvolver_clark_parameters(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		double psf_patch_threshold,
+		size_t max_minor_iter,
+		bool stop_on_rms_increase
+	){
+	GET_LOGGER;
+	if (max_minor_iter == 0){
+		LOG_ERROR("Clark minor cycles must subtract at least one peak, parameters are unchanged");
+		return;
+	}
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
+	deconvolver.clark_psf_patch_threshold = psf_patch_threshold;
+	deconvolver.clark_max_minor_iter = max_minor_iter;
+	deconvolver.clark_stop_on_rms_increase = stop_on_rms_increase;
+}
+
+// "multiscale" deconvolvers use gaussian components with standard deviations 'sigmas' (in
+// pixels, zero is a point), weight how well they fit by 1 - 'bias'*sigma/(largest sigma), crop
+// the PSF convolved with the scales at 'support_threshold' of its maximum, and remake the
+// scale residuals every 'refresh_interval' iterations (zero never does)
+void set_deconvolver_multiscale_parameters(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		const emscripten::val& sigmas,
+		double bias,
+		double support_threshold,
+		size_t refresh_interval
+	){
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
+	deconvolver.multiscale_sigmas = emscripten::vecFromJSArray<double>(sigmas);
+	deconvolver.multiscale_bias = bias;
+	deconvolver.multiscale_support_threshold = support_threshold;
+	deconvolver.multiscale_refresh_interval = refresh_interval;
+}
+
+// "richardson_lucy" deconvolvers extrapolate each iteration's starting point when 'acceleration' is true
+void set_deconvolver_richardson_lucy_parameters(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		bool acceleration
+	){
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
+	deconvolver.richardson_lucy_acceleration = acceleration;
+}
+
+// "fista" deconvolvers weight the L1 norm of their estimate by 'l1_weight', as a fraction of
+// the weight that would make it all zero, and keep it non-negative when 'positive' is true
+void set_deconvolver_fista_parameters(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		double l1_weight,
+		bool positive
+	){
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
+	deconvolver.fista_l1_weight = l1_weight;
+	deconvolver.fista_positive = positive;
+}
+
+// Larger 'regularisation' makes smoother previews, see 'CleanModifiedAlgorithm::preview()'
+void set_deconvolver_preview_regularisation(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		double regularisation
+	){
+	CleanModifiedAlgorithmBase& deconvolver = get_deconvolver<CleanModifiedAlgorithmBase>(deconv_name);
+	deconvolver.preview_regularisation = regularisation;
+}
+
+void set_deconvolver_fft_threads(
+		const std::string& deconv_type,
+		const std::string& deconv_name,
+		size_t n_fft_threads
+	){
+	GET_LOGGER;
+	Deconvolver& deconvolver = get_deconvolver(deconv_name);
+	deconvolver.n_fft_threads = n_fft_threads;
+	if (fft_n_threads(n_fft_threads) != static_cast<int>(n_fft_threads)){
+		LOG_WARN("Asked for % FFT threads, will use %. Build with FFT_THREADS=1 for multithreaded transforms.", n_fft_threads, fft_n_threads(n_fft_threads));
+	}
+}
+
+// Releases the PSFs and PSF spectra kept for re-use, e.g., when a new PSF is loaded
+void clear_psf_cache(){
+	PSFCache::clear();
+}
+
+// 'name' is one of "fftw", "mixed_radix", or "auto" (time both and use the faster for each
+// shape). Applies to deconvolvers prepared after the call.
+void fft_set_backend(const std::string& name){
+	set_fft_backend(fft_backend_from_string(name));
+}
+
+// FFTW keeps separate wisdom for each precision, 'precision' is "double" or "float"
+bool fft_import_wisdom(const std::string& wisdom, const std::string& precision){
+	if (precision == "float") return FFTPlanCache::import_wisdom<float>(wisdom);
+	return FFTPlanCache::import_wisdom<double>(wisdom);
+}
+
+std::string fft_export_wisdom(const std::string& precision){
+	if (precision == "float") return FFTPlanCache::export_wisdom<float>();
+	return FFTPlanCache::export_wisdom<double>();
+}
+
+bool fft_import_wisdom_from_file(const std::string& path, const std::string& precision){
+	if (precision == "float") return FFTPlanCache::import_wisdom_from_file<float>(path);
+	return FFTPlanCache::import_wisdom_from_file<double>(path);
+}
+
+bool fft_export_wisdom_to_file(const std::string& path, const std::string& precision){
+	if (precision == "float") return FFTPlanCache::export_wisdom_to_file<float>(path);
+	return FFTPlanCache::export_wisdom_to_file<double>(path);
+}
+
 
 EMSCRIPTEN_BINDINGS(my_module){
 	function("get_data_max", &get_data_max);
@@ -466,7 +964,12 @@ EMSCRIPTEN_BINDINGS(my_module){
 	function("create_deconvolver", &create_deconvolver);
 	function("prepare_deconvolver", &prepare_deconvolver);
 	function("run_deconvolver", &run_deconvolver);
+	function("pause_deconvolver", &pause_deconvolver);
+	function("preview_deconvolver", &preview_deconvolver);
+	function("get_deconvolver_checkpoint", &get_deconvolver_checkpoint);
+	function("prepare_deconvolver_from_checkpoint", &prepare_deconvolver_from_checkpoint);
 	function("get_deconvolver_clean_map", &get_deconvolver_clean_map);
+	function("get_deconvolver_extra_clean_map", &get_deconvolver_extra_clean_map);
 	function("get_deconvolver_residual", &get_deconvolver_residual);
 	function("remove_image", &remove_image);
 	function("TIFF_get_width", &TIFF_get_width);
@@ -481,6 +984,24 @@ EMSCRIPTEN_BINDINGS(my_module){
 	function("Image_get_width", &Image_get_width);
 	
 	function("set_deconvolver_parameters",&set_deconvolver_parameters);
+	function("set_deconvolver_extra_clean_beams", &set_deconvolver_extra_clean_beams);
+	function("set_deconvolver_fft_plan_rigor", &set_deconvolver_fft_plan_rigor);
+	function("set_deconvolver_update_mode", &set_deconvolver_update_mode);
+	function("set_deconvolver_separable_psf_error", &set_deconvolver_separable_psf_error);
+	function("set_deconvolver_psf_symmetry_tolerance", &set_deconvolver_psf_symmetry_tolerance);
+	function("set_deconvolver_clark_parameters", &set_deconvolver_clark_parameters);
+	function("set_deconvolver_multiscale_parameters", &set_deconvolver_multiscale_parameters);
+	function("set_deconvolver_richardson_lucy_parameters", &set_deconvolver_richardson_lucy_parameters);
+	function("set_deconvolver_fista_parameters", &set_deconvolver_fista_parameters);
+	function("set_deconvolver_preview_regularisation", &set_deconvolver_preview_regularisation);
+	function("set_deconvolver_fft_threads", &set_deconvolver_fft_threads);
+	
+	function("clear_psf_cache", &clear_psf_cache);
+	function("fft_set_backend", &fft_set_backend);
+	function("fft_import_wisdom", &fft_import_wisdom);
+	function("fft_export_wisdom", &fft_export_wisdom);
+	function("fft_import_wisdom_from_file", &fft_import_wisdom_from_file);
+	function("fft_export_wisdom_to_file", &fft_export_wisdom_to_file);
 
 };
 
@@ -3,6 +3,8 @@
 
 #include <list>
 #include <functional>
+#include <memory>
+#include <set>
 #include "deconv.hpp"
 #include "emscripten.h"
 #include "emscripten/bind.h"
@@ -2,8 +2,21 @@
 
 //import ImageHolder from "./image_holder.js"
 
+// "clean_modified", "hogbom", "clark", "multiscale", "richardson_lucy", or "fista". Hogbom
+// and Clark CLEAN are much faster on fields of point sources, multi-scale CLEAN on extended
+// emission, Richardson-Lucy suits non-negative data such as microscopy images, and FISTA
+// dense fields.
 let deconv_type = "clean_modified"
 let deconv_name = "test_deconvolver"
+// "double" or "float", single precision halves memory use and is usually faster
+let deconv_precision = "double"
+// When true all colour channels are deconvolved together, sharing batched FFTs
+let deconv_batch_channels = false
+// "auto" times FFTW and the mixed radix FFT for each frame size and uses the faster,
+// "fftw" or "mixed_radix" force one, e.g., to compare them on the same frames
+let fft_backend = "auto"
+// Standard deviations (in pixels) of further clean beams, each gives another clean map
+let deconv_extra_clean_beam_sigmas = []
 let deconv_complete = false
 
 let scratch_canvas = document.getElementById("canvas")
@@ -25,6 +38,7 @@ let download_clean_map_button = document.getElementById("download-clean-map-butt
 let download_residual_button = document.getElementById("download-residual-button")
 
 let run_deconv_button = document.getElementById("run_deconv")
+let preview_deconv_button = document.getElementById("preview_deconv")
 let n_max_iter_field = document.getElementById("n_max_iter")
 
 let gen_psf_button = document.getElementById("gen_psf_button")
@@ -277,6 +291,8 @@ run_deconv_button.addEventListener("click",
 		try{
 			e.target.textContent = "Deconvolution in progress..."
 			e.target.disabled = true
+			// A preview would replace the deconvolver while it runs
+			preview_deconv_button.disabled = true
 			
 			
 			if ((sci_image_holder.name === null) || (psf_image_holder.name === null)) {
@@ -297,7 +313,10 @@ run_deconv_button.addEventListener("click",
 			deconv_status_mgr.set("Results Available", false, {"is-good":false})
 			console.log("Creating deconvolver")
 			
-			await Module.create_deconvolver(deconv_type, deconv_name)
+			if ((await Module.create_deconvolver(deconv_type, deconv_name, deconv_precision, deconv_batch_channels)) != 0){
+				alert("ERROR: Could not create the deconvolver, see the console for details.")
+				return
+			}
 
 			// Check for invalid params again when we set the values
 			invalid_params = clean_modified_params.set_params(deconv_type, deconv_name)
@@ -307,8 +326,19 @@ run_deconv_button.addEventListener("click",
 				return;
 			}
 			
+			Module.set_deconvolver_extra_clean_beams(deconv_type, deconv_name, deconv_extra_clean_beam_sigmas)
+
 			//console.log("run_deconv_button.addEventListener::click", Math.log10(clean_modified_params.valueOf("fabs_frac_threshold")))
 
+			// Re-use FFT plans measured in previous sessions, FFTW keeps separate wisdom for each precision
+			const fftw_wisdom_key = (deconv_precision == "float") ? "fftwf_wisdom" : "fftw_wisdom"
+			const fftw_wisdom = localStorage.getItem(fftw_wisdom_key)
+			if (fftw_wisdom !== null){
+				Module.fft_import_wisdom(fftw_wisdom, deconv_precision)
+			}
+			Module.set_deconvolver_fft_plan_rigor(deconv_type, deconv_name, "measure")
+			Module.fft_set_backend(fft_backend)
+
 			console.log(`Preparing deconvolver for ${sci_image_holder.name} ${psf_image_holder.name}`)
 			let err_msg = await Module.prepare_deconvolver(deconv_type, deconv_name, sci_image_holder.name, psf_image_holder.name, "")
 			
@@ -329,6 +359,8 @@ run_deconv_button.addEventListener("click",
 			console.log("Running prepared deconvolver")
 			await Module.run_deconvolver(deconv_type, deconv_name)
 			
+			localStorage.setItem(fftw_wisdom_key, Module.fft_export_wisdom(deconv_precision))
+			
 			deconv_complete = true
 			deconv_status_mgr.set("Deconvolution Running", false)
 			
@@ -374,6 +406,66 @@ run_deconv_button.addEventListener("click",
 		finally {
 			e.target.textContent = "Run Deconvolution"
 			e.target.disabled = false
+			preview_deconv_button.disabled = false
+		}
+	}
+)
+
+// A Wiener filtered estimate that takes milliseconds, to check the PSF and parameters before a full run
+preview_deconv_button.addEventListener("click", 
+	async (e)=>{
+		try{
+			e.target.disabled = true
+			run_deconv_button.disabled = true
+			
+			if ((sci_image_holder.name === null) || (psf_image_holder.name === null)) {
+				console.error("Input data is missing")
+				alert("ERROR: Missing input data.\n\nPreview requires upload of a science image and a psf image")
+				return
+			}
+			
+			// Preview results are not the deconvolution's, so are not available to download
+			deconv_complete = false
+			deconv_status_mgr.set("Results Available", false, {"is-good":false})
+			
+			if ((await Module.create_deconvolver(deconv_type, deconv_name, deconv_precision, deconv_batch_channels)) != 0){
+				alert("ERROR: Could not create the deconvolver, see the console for details.")
+				return
+			}
+			let invalid_params = clean_modified_params.set_params(deconv_type, deconv_name)
+			if(invalid_params.length != 0){
+				alert(`ERROR: Could not preview deconvolution.\n\nThe following parameters are invalid and need to be corrected:\n\t${invalid_params.join("\n\t")}`)
+				return;
+			}
+			
+			console.log(`Previewing deconvolution of ${sci_image_holder.name} ${psf_image_holder.name}`)
+			let err_msg = await Module.preview_deconvolver(deconv_type, deconv_name, sci_image_holder.name, psf_image_holder.name)
+			if (err_msg.length >0){
+				console.error(err_msg)
+				alert(`ERROR: ${err_msg}`)
+				return
+			}
+			
+			let width = sci_image_holder.im_w
+			let height = sci_image_holder.im_h
+			deconv_clean_map = getImageDataFromResult(
+				Module.get_deconvolver_clean_map, 
+				[deconv_type, deconv_name], 
+				width, 
+				height
+			)
+			clean_map_canvas.width = width
+			clean_map_canvas.height = height
+			clean_map_canvas.getContext("2d").putImageData(deconv_clean_map,0,0)
+		}
+		catch (e){
+			let msg = `An error occured during preview. Recieved error message: ${e.message}`
+			console.error(msg)
+			alert(msg)
+		}
+		finally {
+			e.target.disabled = false
+			run_deconv_button.disabled = false
 		}
 	}
 )
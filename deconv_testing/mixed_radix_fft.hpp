@@ -0,0 +1,456 @@
+#ifndef __MIXED_RADIX_FFT_INCLUDED__
+#define __MIXED_RADIX_FFT_INCLUDED__
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+
+// Header-only multi-dimensional FFT, an alternative to FFTW that needs no library. Each
+// axis is transformed by a mixed-radix Stockham (self-sorting) FFT, with specialised
+// butterflies for radices 2, 3, 4 and 5 and a direct DFT for other factors, so it is fastest
+// for sizes with small prime factors (see 'next_fast_fft_size()') but works for any size.
+// Real transforms of even length are done as complex transforms of half the length.
+//
+// Conventions match FFTW's, so the two can be swapped: 'shape' has the slowest varying axis
+// first, forward transforms use exp(-2 pi i jk/n), nothing is normalised, real transforms
+// only hold the (n/2+1) non-redundant elements of the last axis, and 'n_batch' arrays are
+// stored one after another. Complex-to-real transforms overwrite their input.
+// Executing is const and allocates its own scratch space, so a plan can be shared.
+template<class T=double>
+class MixedRadixFFT{
+	public:
+	using complex=std::complex<T>;
+
+	// Transforms 'n_interleaved' sequences of length 'n' at once, element j of sequence c
+	// is at 'c + n_interleaved*j'. Rows use one sequence, the other axes of an array
+	// transform every line along them together so memory is accessed contiguously.
+	class Plan1D{
+		public:
+		size_t n;
+		std::vector<size_t> factors;
+		// exp(-2 pi i t/n) for t < n, and their conjugates for inverse transforms
+		std::vector<complex> twiddles;
+		std::vector<complex> inverse_twiddles;
+		// For each factor without a specialised butterfly, the p*p matrix of its direct DFT,
+		// W_p^(rk) at 'k*p + r'. Empty for the other factors.
+		std::vector<std::vector<complex>> dft_twiddles;
+		std::vector<std::vector<complex>> inverse_dft_twiddles;
+
+		Plan1D(size_t _n=1) : n(_n), factors(), twiddles(_n), inverse_twiddles(_n), dft_twiddles(), inverse_dft_twiddles() {
+			for(size_t f : {4, 2, 3, 5}){
+				while((_n > 1) && (_n % f == 0)){
+					factors.push_back(f);
+					_n /= f;
+				}
+			}
+			for(size_t f=7; _n>1; f+=2){
+				while(_n % f == 0){
+					factors.push_back(f);
+					_n /= f;
+				}
+			}
+			for(size_t t=0; t<n; ++t){
+				const double angle = -2*M_PI*static_cast<double>(t)/n;
+				twiddles[t] = complex(static_cast<T>(std::cos(angle)), static_cast<T>(std::sin(angle)));
+				inverse_twiddles[t] = std::conj(twiddles[t]);
+			}
+			// W_p^(rk) is w[(rk mod p)*(n/p)]
+			for(const size_t p : factors){
+				dft_twiddles.emplace_back();
+				inverse_dft_twiddles.emplace_back();
+				if (p <= 5){
+					continue;
+				}
+				dft_twiddles.back().resize(p*p);
+				inverse_dft_twiddles.back().resize(p*p);
+				for(size_t k=0; k<p; ++k){
+					for(size_t r=0; r<p; ++r){
+						dft_twiddles.back()[k*p + r] = twiddles[((r*k) % p)*(n/p)];
+						inverse_dft_twiddles.back()[k*p + r] = inverse_twiddles[((r*k) % p)*(n/p)];
+					}
+				}
+			}
+		}
+
+		// 'data' and 'scratch' hold 'n*n_interleaved' elements, the result is left in 'data'
+		void transform(complex* data, complex* scratch, size_t n_interleaved, bool inverse) const {
+			const complex* w = inverse ? inverse_twiddles.data() : twiddles.data();
+			complex* x = data;
+			complex* y = scratch;
+			size_t len = n;
+			size_t s = n_interleaved;
+			for(size_t f=0; f<factors.size(); ++f){
+				const size_t p = factors[f];
+				// Each stage does 'len/p' size 'p' DFTs of every one of the 's' interleaved
+				// sub-sequences, multiplying their outputs by twiddles of 'len'.
+				const size_t m = len/p;
+				const size_t step = n/len;
+				switch(p){
+					case 2: _stage_2(x, y, m, s, step, w); break;
+					case 3: _stage_3(x, y, m, s, step, w, inverse); break;
+					case 4: _stage_4(x, y, m, s, step, w, inverse); break;
+					case 5: _stage_5(x, y, m, s, step, w, inverse); break;
+					default: _stage_generic(p, x, y, m, s, step, w, inverse ? inverse_dft_twiddles[f].data() : dft_twiddles[f].data()); break;
+				}
+				std::swap(x, y);
+				len = m;
+				s *= p;
+			}
+			if (x != data){
+				std::copy(x, x + n*n_interleaved, data);
+			}
+		}
+
+		private:
+		static complex _mul(const complex& a, const complex& b){
+			// std::complex's operator* checks for NANs and does not vectorise
+			return complex(a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real());
+		}
+
+		// i*a for forward transforms and -i*a for inverse ones, i.e., -sign*i*a
+		static complex _rotate(const complex& a, bool inverse){
+			return inverse ? complex(a.imag(), -a.real()) : complex(-a.imag(), a.real());
+		}
+
+		// In every stage input r of DFT j (of sub-sequence q) is x[q + s*(j + r*m)], and
+		// output k goes to y[q + s*(p*j + k)] after multiplying by w[j*k*step].
+		static void _stage_2(const complex* x, complex* y, size_t m, size_t s, size_t step, const complex* w){
+			for(size_t j=0; j<m; ++j){
+				const complex w1 = w[j*step];
+				const complex* in = x + s*j;
+				complex* out = y + s*2*j;
+				for(size_t q=0; q<s; ++q){
+					const complex a0 = in[q], a1 = in[q + s*m];
+					out[q] = a0 + a1;
+					out[q + s] = _mul(a0 - a1, w1);
+				}
+			}
+		}
+
+		static void _stage_3(const complex* x, complex* y, size_t m, size_t s, size_t step, const complex* w, bool inverse){
+			constexpr T half_sqrt3 = T(0.86602540378443864676);
+			for(size_t j=0; j<m; ++j){
+				const complex w1 = w[j*step], w2 = w[2*j*step];
+				const complex* in = x + s*j;
+				complex* out = y + s*3*j;
+				for(size_t q=0; q<s; ++q){
+					const complex a0 = in[q], a1 = in[q + s*m], a2 = in[q + 2*s*m];
+					const complex sum = a1 + a2;
+					const complex t1 = a0 - T(0.5)*sum;
+					// -sign*i*sqrt(3)/2*(a1 - a2)
+					const complex t2 = -half_sqrt3*_rotate(a1 - a2, inverse);
+					out[q] = a0 + sum;
+					out[q + s] = _mul(t1 + t2, w1);
+					out[q + 2*s] = _mul(t1 - t2, w2);
+				}
+			}
+		}
+
+		static void _stage_4(const complex* x, complex* y, size_t m, size_t s, size_t step, const complex* w, bool inverse){
+			for(size_t j=0; j<m; ++j){
+				const complex w1 = w[j*step], w2 = w[2*j*step], w3 = w[3*j*step];
+				const complex* in = x + s*j;
+				complex* out = y + s*4*j;
+				for(size_t q=0; q<s; ++q){
+					const complex a0 = in[q], a1 = in[q + s*m], a2 = in[q + 2*s*m], a3 = in[q + 3*s*m];
+					const complex s02 = a0 + a2, d02 = a0 - a2;
+					const complex s13 = a1 + a3;
+					const complex rot = -_rotate(a1 - a3, inverse);
+					out[q] = s02 + s13;
+					out[q + s] = _mul(d02 + rot, w1);
+					out[q + 2*s] = _mul(s02 - s13, w2);
+					out[q + 3*s] = _mul(d02 - rot, w3);
+				}
+			}
+		}
+
+		static void _stage_5(const complex* x, complex* y, size_t m, size_t s, size_t step, const complex* w, bool inverse){
+			// cos and sin of 2 pi/5 and 4 pi/5
+			constexpr T c1 = T(0.30901699437494742410), c2 = T(-0.80901699437494742410);
+			constexpr T s1 = T(0.95105651629515357212), s2 = T(0.58778525229247312917);
+			for(size_t j=0; j<m; ++j){
+				const complex w1 = w[j*step], w2 = w[2*j*step], w3 = w[3*j*step], w4 = w[4*j*step];
+				const complex* in = x + s*j;
+				complex* out = y + s*5*j;
+				for(size_t q=0; q<s; ++q){
+					const complex a0 = in[q], a1 = in[q + s*m], a2 = in[q + 2*s*m], a3 = in[q + 3*s*m], a4 = in[q + 4*s*m];
+					const complex t1 = a1 + a4, t2 = a2 + a3;
+					const complex t3 = a1 - a4, t4 = a2 - a3;
+					const complex t5 = a0 + c1*t1 + c2*t2;
+					const complex t6 = a0 + c2*t1 + c1*t2;
+					const complex t7 = -_rotate(s1*t3 + s2*t4, inverse);
+					const complex t8 = -_rotate(s2*t3 - s1*t4, inverse);
+					out[q] = a0 + t1 + t2;
+					out[q + s] = _mul(t5 + t7, w1);
+					out[q + 2*s] = _mul(t6 + t8, w2);
+					out[q + 3*s] = _mul(t6 - t8, w3);
+					out[q + 4*s] = _mul(t5 - t7, w4);
+				}
+			}
+		}
+
+		// Direct DFT for other radices, O(p^2) per DFT. 'dft' is the factor's matrix from 'dft_twiddles'.
+		static void _stage_generic(size_t p, const complex* x, complex* y, size_t m, size_t s, size_t step, const complex* w, const complex* dft){
+			for(size_t j=0; j<m; ++j){
+				const complex* in = x + s*j;
+				complex* out = y + s*p*j;
+				for(size_t k=0; k<p; ++k){
+					const complex wk = w[j*k*step];
+					const complex* dft_row = dft + k*p;
+					for(size_t q=0; q<s; ++q){
+						complex acc = in[q];
+						for(size_t r=1; r<p; ++r){
+							acc += _mul(in[q + r*s*m], dft_row[r]);
+						}
+						out[q + k*s] = _mul(acc, wk);
+					}
+				}
+			}
+		}
+	};
+
+	// Lines are gathered into interleaved blocks of this many, so every axis is transformed
+	// with contiguous, cache sized, inner loops
+	static constexpr size_t block_size = 16;
+
+	// Prime factors above this use the O(p^2) direct DFT, and are slow enough that automatic
+	// backend selection does not consider this FFT for them, see 'next_fast_fft_size()'.
+	static constexpr size_t max_fast_radix = 7;
+
+	// Largest prime factor of any axis length of 'shape', 1 for an empty shape
+	static size_t largest_prime_factor(const std::vector<size_t>& shape){
+		size_t largest = 1;
+		for(size_t n : shape){
+			for(size_t f=2; f*f<=n; ++f){
+				while(n % f == 0){
+					largest = std::max(largest, f);
+					n /= f;
+				}
+			}
+			largest = std::max(largest, n);
+		}
+		return largest;
+	}
+
+	std::vector<size_t> shape; // slowest varying axis first
+	bool inverse;
+	bool real_transform;
+	size_t n_batch;
+	size_t size; // of one array
+	size_t spectrum_size; // of one array
+	// One plan for each axis, for real transforms of even length the last plan is half length
+	std::vector<Plan1D> axis_plans;
+	// exp(-2 pi i k/n) for k <= n/2, where n is the length of the last axis, used to
+	// split the half length transform of real data
+	std::vector<complex> real_twiddles;
+
+	MixedRadixFFT(
+			const std::vector<size_t>& _shape,
+			const bool _inverse,
+			const bool _real_transform,
+			const size_t _n_batch = 1
+		) : shape(_shape)
+		, inverse(_inverse)
+		, real_transform(_real_transform)
+		, n_batch(_n_batch)
+		, size(std::accumulate(_shape.begin(), _shape.end(), size_t(1), std::multiplies<size_t>()))
+		, spectrum_size(size)
+		, axis_plans()
+		, real_twiddles()
+	{
+		for(size_t a=0; a<shape.size(); ++a){
+			axis_plans.emplace_back(_is_half_length_axis(a) ? shape[a]/2 : shape[a]);
+		}
+		if (real_transform && (shape.size() > 0)){
+			const size_t n = shape.back();
+			spectrum_size = (size/n)*(n/2 + 1);
+			real_twiddles.resize(n/2 + 1);
+			for(size_t k=0; k<=n/2; ++k){
+				const double angle = -2*M_PI*static_cast<double>(k)/n;
+				real_twiddles[k] = complex(static_cast<T>(std::cos(angle)), static_cast<T>(std::sin(angle)));
+			}
+		}
+	}
+
+	// Complex-to-complex, 'in' and 'out' hold 'n_batch*size' elements
+	void execute(const complex* in, complex* out) const {
+		assert(!real_transform);
+		std::copy(in, in + n_batch*size, out);
+		std::vector<complex> buffer(_buffer_size()), scratch(_buffer_size());
+		for(size_t b=0; b<n_batch; ++b){
+			_transform_axes(out + b*size, shape, shape.size(), buffer.data(), scratch.data());
+		}
+	}
+
+	// Real-to-complex, 'in' holds 'n_batch*size' and 'out' 'n_batch*spectrum_size' elements
+	void execute(const T* in, complex* out) const {
+		assert(real_transform && !inverse);
+		std::vector<complex> buffer(_buffer_size()), scratch(_buffer_size());
+		for(size_t b=0; b<n_batch; ++b){
+			complex* spectrum = out + b*spectrum_size;
+			_r2c_rows(in + b*size, spectrum, buffer.data(), scratch.data());
+			_transform_axes(spectrum, _spectrum_shape(), shape.size()-1, buffer.data(), scratch.data());
+		}
+	}
+
+	// Complex-to-real, 'in' holds 'n_batch*spectrum_size' and 'out' 'n_batch*size' elements.
+	// NOTE: overwrites 'in'
+	void execute(complex* in, T* out) const {
+		assert(real_transform && inverse);
+		std::vector<complex> buffer(_buffer_size()), scratch(_buffer_size());
+		for(size_t b=0; b<n_batch; ++b){
+			complex* spectrum = in + b*spectrum_size;
+			_transform_axes(spectrum, _spectrum_shape(), shape.size()-1, buffer.data(), scratch.data());
+			_c2r_rows(spectrum, out + b*size, buffer.data(), scratch.data());
+		}
+	}
+
+	private:
+	bool _is_half_length_axis(size_t a) const {
+		return real_transform && (a+1 == shape.size()) && (shape[a]%2 == 0);
+	}
+
+	std::vector<size_t> _spectrum_shape() const {
+		std::vector<size_t> spectrum_shape(shape);
+		spectrum_shape.back() = shape.back()/2 + 1;
+		return spectrum_shape;
+	}
+
+	// Enough for a block of the longest lines
+	size_t _buffer_size() const {
+		const size_t longest = shape.empty() ? 1 : *std::max_element(shape.begin(), shape.end());
+		return block_size*longest;
+	}
+
+	// Transforms the first 'n_axes' axes of 'data', an array of 'dims', in place
+	void _transform_axes(complex* data, const std::vector<size_t>& dims, size_t n_axes, complex* buffer, complex* scratch) const {
+		const size_t total = std::accumulate(dims.begin(), dims.end(), size_t(1), std::multiplies<size_t>());
+		std::vector<complex*> lines(block_size);
+		for(size_t a=0; a<n_axes; ++a){
+			const size_t n = dims[a];
+			if (n == 1){
+				continue;
+			}
+			// Line l starts at '(l/stride)*n*stride + l%stride', its elements are 'stride' apart
+			const size_t stride = std::accumulate(dims.begin()+a+1, dims.end(), size_t(1), std::multiplies<size_t>());
+			const size_t n_lines = total/n;
+			for(size_t l0=0; l0<n_lines; l0+=block_size){
+				const size_t nb = std::min(block_size, n_lines - l0);
+				for(size_t c=0; c<nb; ++c){
+					const size_t l = l0 + c;
+					lines[c] = data + (l/stride)*n*stride + l%stride;
+				}
+				for(size_t j=0; j<n; ++j){
+					for(size_t c=0; c<nb; ++c){
+						buffer[j*nb + c] = lines[c][j*stride];
+					}
+				}
+				axis_plans[a].transform(buffer, scratch, nb, inverse);
+				for(size_t j=0; j<n; ++j){
+					for(size_t c=0; c<nb; ++c){
+						lines[c][j*stride] = buffer[j*nb + c];
+					}
+				}
+			}
+		}
+	}
+
+	// Transforms each row (along the last axis) of 'x' into the non-redundant half of its spectrum
+	void _r2c_rows(const T* x, complex* X, complex* buffer, complex* scratch) const {
+		const size_t n = shape.back();
+		const size_t nh = n/2 + 1;
+		const size_t h = n/2;
+		const size_t n_rows = size/n;
+		const Plan1D& plan = axis_plans.back();
+		for(size_t r0=0; r0<n_rows; r0+=block_size){
+			const size_t nb = std::min(block_size, n_rows - r0);
+			const T* x_rows = x + r0*n;
+			complex* X_rows = X + r0*nh;
+			if (n%2 != 0){
+				for(size_t j=0; j<n; ++j){
+					for(size_t c=0; c<nb; ++c){
+						buffer[j*nb + c] = complex(x_rows[c*n + j], 0);
+					}
+				}
+				plan.transform(buffer, scratch, nb, false);
+				for(size_t c=0; c<nb; ++c){
+					for(size_t k=0; k<nh; ++k){
+						X_rows[c*nh + k] = buffer[k*nb + c];
+					}
+				}
+				continue;
+			}
+			// Even and odd samples are the real and imaginary parts of a half length transform
+			for(size_t j=0; j<h; ++j){
+				for(size_t c=0; c<nb; ++c){
+					buffer[j*nb + c] = complex(x_rows[c*n + 2*j], x_rows[c*n + 2*j + 1]);
+				}
+			}
+			plan.transform(buffer, scratch, nb, false);
+			for(size_t c=0; c<nb; ++c){
+				for(size_t k=0; k<=h; ++k){
+					const complex z = buffer[(k%h)*nb + c];
+					const complex zc = std::conj(buffer[((h-k)%h)*nb + c]);
+					const complex even = T(0.5)*(z + zc);
+					const complex d = z - zc;
+					const complex odd(T(0.5)*d.imag(), T(-0.5)*d.real()); // (z - zc)/2i
+					const complex w = real_twiddles[k];
+					X_rows[c*nh + k] = even + complex(w.real()*odd.real() - w.imag()*odd.imag(), w.real()*odd.imag() + w.imag()*odd.real());
+				}
+			}
+		}
+	}
+
+	// Inverse of '_r2c_rows()', without normalisation
+	void _c2r_rows(const complex* X, T* x, complex* buffer, complex* scratch) const {
+		const size_t n = shape.back();
+		const size_t nh = n/2 + 1;
+		const size_t h = n/2;
+		const size_t n_rows = size/n;
+		const Plan1D& plan = axis_plans.back();
+		for(size_t r0=0; r0<n_rows; r0+=block_size){
+			const size_t nb = std::min(block_size, n_rows - r0);
+			const complex* X_rows = X + r0*nh;
+			T* x_rows = x + r0*n;
+			if (n%2 != 0){
+				for(size_t c=0; c<nb; ++c){
+					for(size_t k=0; k<n; ++k){
+						buffer[k*nb + c] = (k < nh) ? X_rows[c*nh + k] : std::conj(X_rows[c*nh + n - k]);
+					}
+				}
+				plan.transform(buffer, scratch, nb, true);
+				for(size_t j=0; j<n; ++j){
+					for(size_t c=0; c<nb; ++c){
+						x_rows[c*n + j] = buffer[j*nb + c].real();
+					}
+				}
+				continue;
+			}
+			// Re-combine into the half length transform of (even + i*odd) samples
+			for(size_t c=0; c<nb; ++c){
+				for(size_t k=0; k<h; ++k){
+					const complex xc = std::conj(X_rows[c*nh + h - k]);
+					const complex even = X_rows[c*nh + k] + xc;
+					const complex d = X_rows[c*nh + k] - xc;
+					const complex w = std::conj(real_twiddles[k]);
+					const complex odd(w.real()*d.real() - w.imag()*d.imag(), w.real()*d.imag() + w.imag()*d.real());
+					buffer[k*nb + c] = complex(even.real() - odd.imag(), even.imag() + odd.real()); // even + i*odd
+				}
+			}
+			plan.transform(buffer, scratch, nb, true);
+			for(size_t j=0; j<h; ++j){
+				for(size_t c=0; c<nb; ++c){
+					x_rows[c*n + 2*j] = buffer[j*nb + c].real();
+					x_rows[c*n + 2*j + 1] = buffer[j*nb + c].imag();
+				}
+			}
+		}
+	}
+};
+
+#endif //__MIXED_RADIX_FFT_INCLUDED__
@@ -0,0 +1,89 @@
+#include "psf_cache.hpp"
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include "logging.h"
+
+
+namespace PSFCache{
+	// Entries, and the order they were inserted in so the oldest can be evicted
+	template<class T>
+	struct Store{
+		std::map<Key, std::pair<size_t, std::shared_ptr<const Entry<T>>>> entries;
+		size_t n_inserted = 0;
+	};
+
+	template<class T>
+	Store<T>& _store(){
+		static Store<T> store;
+		return store;
+	}
+
+	std::mutex& _mutex(){
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	template<class T>
+	Key make_key(
+			const std::vector<T>& psf_data,
+			const std::vector<size_t>& psf_shape,
+			const std::vector<size_t>& working_shape,
+			const std::string& centering_mode
+		){
+		// FNV-1a over the bytes of the values
+		size_t hash = 14695981039346656037ULL;
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(psf_data.data());
+		for(size_t i=0; i<psf_data.size()*sizeof(T); ++i){
+			hash = (hash ^ bytes[i])*1099511628211ULL;
+		}
+		return Key{hash, psf_shape, working_shape, centering_mode};
+	}
+
+	template<class T>
+	std::shared_ptr<const Entry<T>> find(const Key& key, const std::vector<T>& psf_data){
+		std::lock_guard<std::mutex> lock(_mutex());
+		Store<T>& store = _store<T>();
+		auto it = store.entries.find(key);
+		if ((it == store.entries.end()) || (it->second.second->psf_data != psf_data)){
+			return nullptr;
+		}
+		return it->second.second;
+	}
+
+	template<class T>
+	void insert(const Key& key, Entry<T> entry){
+		GET_LOGGER;
+		std::lock_guard<std::mutex> lock(_mutex());
+		Store<T>& store = _store<T>();
+		store.entries[key] = {store.n_inserted++, std::make_shared<const Entry<T>>(std::move(entry))};
+
+		if (store.entries.size() > max_size){
+			auto oldest = std::min_element(
+				store.entries.begin(),
+				store.entries.end(),
+				[](const auto& a, const auto& b){return a.second.first < b.second.first;}
+			);
+			LOG_DEBUG("Evicting PSF of shape % at working shape % from cache", oldest->first.psf_shape, oldest->first.working_shape);
+			store.entries.erase(oldest);
+		}
+	}
+
+	size_t size(){
+		std::lock_guard<std::mutex> lock(_mutex());
+		return _store<double>().entries.size() + _store<float>().entries.size();
+	}
+
+	void clear(){
+		std::lock_guard<std::mutex> lock(_mutex());
+		_store<double>().entries.clear();
+		_store<float>().entries.clear();
+	}
+
+	template Key make_key<double>(const std::vector<double>&, const std::vector<size_t>&, const std::vector<size_t>&, const std::string&);
+	template Key make_key<float>(const std::vector<float>&, const std::vector<size_t>&, const std::vector<size_t>&, const std::string&);
+	template std::shared_ptr<const Entry<double>> find<double>(const Key&, const std::vector<double>&);
+	template std::shared_ptr<const Entry<float>> find<float>(const Key&, const std::vector<float>&);
+	template void insert<double>(const Key&, Entry<double>);
+	template void insert<float>(const Key&, Entry<float>);
+}
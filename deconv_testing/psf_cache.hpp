@@ -0,0 +1,70 @@
+#ifndef __PSF_CACHE_INCLUDED__
+#define __PSF_CACHE_INCLUDED__
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <complex>
+#include <compare>
+
+
+// Process-wide store of PSFs prepared for deconvolution, i.e., padded to the working shape,
+// normalised, and centred on pixel 0, along with their spectra. Each colour layer, each
+// named deconvolver, and each science image that uses the same PSF at the same working shape
+// shares one entry, so the PSF is only padded and transformed once.
+// Entries are read-only and handed out as shared pointers, so evicting or replacing an entry
+// never invalidates one a deconvolver is using. Double and float PSFs are kept separately.
+// All functions are thread-safe.
+namespace PSFCache{
+	struct Key{
+		size_t psf_hash; // of the PSF's values, entries keep the values to rule out collisions
+		std::vector<size_t> psf_shape;
+		std::vector<size_t> working_shape;
+		std::string centering_mode;
+
+		auto operator<=>(const Key&) const = default;
+	};
+
+	template<class T=double>
+	struct Entry{
+		std::vector<T> psf_data; // as given, before padding
+		std::shared_ptr<const std::vector<T>> padded_psf_data;
+		// Non-redundant half of the spectrum of 'padded_psf_data', with the 1/size
+		// normalisation of the inverse transform folded in. Null until a deconvolver that
+		// uses full-frame transforms needs it.
+		std::shared_ptr<const std::vector<std::complex<T>>> psf_fft;
+		// Largest difference between 'padded_psf_data' and its point reflection through
+		// pixel 0, as a fraction of its largest absolute value.
+		double asymmetry;
+		// Real part of 'psf_fft', the spectrum of the centrosymmetric part of the PSF. Null
+		// until a deconvolver that treats the PSF as symmetric needs it.
+		std::shared_ptr<const std::vector<T>> psf_fft_real;
+	};
+
+	// Most entries of each precision that are kept, the oldest is evicted first. Entries
+	// are frame sized, so only a few are kept.
+	constexpr size_t max_size = 4;
+
+	template<class T=double>
+	Key make_key(
+		const std::vector<T>& psf_data,
+		const std::vector<size_t>& psf_shape,
+		const std::vector<size_t>& working_shape,
+		const std::string& centering_mode
+	);
+
+	// Returns the entry for 'key' if it was made from 'psf_data', otherwise nullptr
+	template<class T=double>
+	std::shared_ptr<const Entry<T>> find(const Key& key, const std::vector<T>& psf_data);
+
+	// Adds the entry for 'key', replacing any there already
+	template<class T=double>
+	void insert(const Key& key, Entry<T> entry);
+
+	// Number of entries of both precisions
+	size_t size();
+
+	void clear();
+}
+
+#endif //__PSF_CACHE_INCLUDED__
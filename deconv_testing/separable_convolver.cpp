@@ -0,0 +1,132 @@
+#include "separable_convolver.hpp"
+#include <cmath>
+#include <algorithm>
+#include "Eigen/SVD"
+
+
+template<class T>
+SeparableConvolver<T>::SeparableConvolver()
+	: data_shape()
+	, kernel_shape()
+	, kernel_offset()
+	, rank(0)
+	, relative_error(0)
+	, row_filters()
+	, column_filters()
+	, row_pass()
+	, row_is_nonzero()
+{}
+
+template<class T>
+void SeparableConvolver<T>::set_kernel(
+		const std::vector<size_t>& _data_shape,
+		const std::vector<T>& kernel,
+		const std::vector<size_t>& _kernel_shape,
+		const std::vector<size_t>& _kernel_offset,
+		const double max_relative_error
+	){
+	GET_LOGGER;
+	assert(_data_shape.size() == 2);
+	assert(kernel.size() == du::product(_kernel_shape));
+
+	data_shape = _data_shape;
+	kernel_shape = _kernel_shape;
+	kernel_offset = _kernel_offset;
+	const size_t sx = kernel_shape[0], sy = kernel_shape[1];
+
+	// Rows of the matrix are kernel rows, so right singular vectors filter along x
+	Eigen::MatrixXd kernel_matrix(sy, sx);
+	for(size_t j=0; j<sy; ++j){
+		for(size_t i=0; i<sx; ++i){
+			kernel_matrix(j, i) = kernel[i + j*sx];
+		}
+	}
+	Eigen::BDCSVD<Eigen::MatrixXd> svd(kernel_matrix, Eigen::ComputeThinU | Eigen::ComputeThinV);
+	const Eigen::VectorXd& singular_values = svd.singularValues();
+
+	// Singular values are in decreasing order, the error of keeping the first 'rank' is
+	// the root sum of squares of the rest. Summing the rest directly avoids cancellation.
+	const size_t n_values = singular_values.size();
+	const double total = singular_values.squaredNorm();
+	double left_out = total;
+	rank = 0;
+	while ((rank < n_values) && (singular_values[rank] > 0) && (left_out > max_relative_error*max_relative_error*total)){
+		++rank;
+		left_out = singular_values.tail(n_values - rank).squaredNorm();
+	}
+	relative_error = (total > 0) ? std::sqrt(left_out/total) : 0;
+	LOGV_DEBUG(kernel_shape, rank, relative_error);
+
+	row_filters.resize(rank*sx);
+	column_filters.resize(rank*sy);
+	for(size_t k=0; k<rank; ++k){
+		const double scale = std::sqrt(singular_values[k]);
+		for(size_t i=0; i<sx; ++i){
+			row_filters[k*sx + i] = scale*svd.matrixV()(i, k);
+		}
+		for(size_t j=0; j<sy; ++j){
+			column_filters[k*sy + j] = scale*svd.matrixU()(j, k);
+		}
+	}
+
+	row_pass.resize(data_shape[0]);
+	row_is_nonzero.resize(data_shape[1]);
+}
+
+template<class T>
+void SeparableConvolver<T>::convolve(std::span<const T> input, std::span<T> output){
+	assert((input.size() == du::product(data_shape)) && (output.size() == input.size()));
+	const size_t nx = data_shape[0], ny = data_shape[1];
+	const size_t sx = kernel_shape[0], sy = kernel_shape[1];
+
+	std::fill(output.begin(), output.end(), T(0));
+
+	// Rows of the input that have anything to convolve
+	for(size_t y=0; y<ny; ++y){
+		const T* in_row = input.data() + y*nx;
+		row_is_nonzero[y] = std::any_of(in_row, in_row + nx, [](T v){return v != 0;});
+	}
+
+	for(size_t k=0; k<rank; ++k){
+		const T* row_filter = row_filters.data() + k*sx;
+		const T* column_filter = column_filters.data() + k*sy;
+
+		for(size_t y0=0; y0<ny; ++y0){
+			if (!row_is_nonzero[y0]){
+				continue;
+			}
+			// Row filters are split in two where they wrap around the edge of the frame
+			const T* in_row = input.data() + y0*nx;
+			T* pass_row = row_pass.data();
+			std::fill(pass_row, pass_row + nx, T(0));
+			for(size_t x0=0; x0<nx; ++x0){
+				const T v = in_row[x0];
+				if (v == 0){
+					continue;
+				}
+				const size_t x_start = (x0 + nx - kernel_offset[0]) % nx;
+				const size_t n_before_wrap = std::min(sx, nx - x_start);
+				for(size_t i=0; i<n_before_wrap; ++i){
+					pass_row[x_start + i] += v*row_filter[i];
+				}
+				for(size_t i=n_before_wrap; i<sx; ++i){
+					pass_row[i - n_before_wrap] += v*row_filter[i];
+				}
+			}
+
+			// The filtered row spreads over 'sy' output rows
+			size_t y = (y0 + ny - kernel_offset[1]) % ny;
+			for(size_t j=0; j<sy; ++j){
+				const T w = column_filter[j];
+				T* out_row = output.data() + y*nx;
+				for(size_t x=0; x<nx; ++x){
+					out_row[x] += w*pass_row[x];
+				}
+				y = (y+1 == ny) ? 0 : y+1;
+			}
+		}
+	}
+}
+
+template class SeparableConvolver<double>;
+template class SeparableConvolver<float>;
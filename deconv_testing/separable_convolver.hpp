@@ -0,0 +1,59 @@
+#ifndef __SEPARABLE_CONVOLVER_INCLUDED__
+#define __SEPARABLE_CONVOLVER_INCLUDED__
+
+#include <vector>
+#include <span>
+#include "data_utils.hpp"
+#include "logging.h"
+
+namespace du = data_utils;
+
+
+// Convolution of a 2D frame with a small kernel approximated by a sum of a few separable
+// (rank-1) terms, i.e., kernel(x,y) ~ sum_k row_filter_k(x)*column_filter_k(y). The terms
+// come from a singular value decomposition of the kernel, truncated to the fewest that
+// keep the kernel within an error bound. Each term is a pass along the rows followed by a
+// pass along the columns, so a kernel of shape {sx,sy} costs about rank*(sx+sy) operations
+// per pixel instead of sx*sy. Zero input pixels and rows are skipped.
+//
+// As for 'TiledConvolver', the result is the circular convolution of the input with the
+// (approximated) kernel over the frame.
+// 'T' is the precision of the data, the decomposition is always done in double precision.
+template<class T=double>
+class SeparableConvolver{
+	public:
+	// All shapes are {x,y}, x is the fastest varying axis
+	std::vector<size_t> data_shape;
+	std::vector<size_t> kernel_shape;
+	// pixel of the kernel that is its origin, i.e., the kernel's value at zero shift
+	std::vector<size_t> kernel_offset;
+	// number of separable terms kept, and the Frobenius norm of the terms left out as a
+	// fraction of the kernel's
+	size_t rank;
+	double relative_error;
+
+	// 'rank' filters one after another, singular values are split evenly between them
+	std::vector<T> row_filters;
+	std::vector<T> column_filters;
+	// One input row after a row pass, and which input rows are non-zero
+	std::vector<T> row_pass;
+	std::vector<bool> row_is_nonzero;
+
+	SeparableConvolver();
+
+	// Keeps the fewest terms whose Frobenius norm error is at most 'max_relative_error'
+	// of the kernel's, zero keeps every term with a non-zero singular value.
+	void set_kernel(
+		const std::vector<size_t>& _data_shape,
+		const std::vector<T>& kernel,
+		const std::vector<size_t>& _kernel_shape,
+		const std::vector<size_t>& _kernel_offset,
+		const double max_relative_error = 1E-3
+	);
+
+	// Writes the convolution of 'input' with the approximated kernel into 'output', both
+	// have 'data_shape' and must not overlap.
+	void convolve(std::span<const T> input, std::span<T> output);
+};
+
+#endif //__SEPARABLE_CONVOLVER_INCLUDED__
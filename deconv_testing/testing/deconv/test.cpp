@@ -0,0 +1,342 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "logging.h"
+#include "data_utils.hpp"
+#include "deconv.hpp"
+
+namespace du = data_utils;
+
+int n_failures = 0;
+
+void check(bool result, const std::string& msg){
+	std::cout << (result ? "PASS: " : "FAIL: ") << msg << std::endl;
+	if(!result) ++n_failures;
+}
+
+// Frames have FFT friendly sizes so they are not padded, pixel (x, y) is at x + y*nx
+const std::vector<size_t> obs_shape{64, 48};
+const std::vector<size_t> psf_shape{15, 15};
+
+// Unit-sum gaussian centred on the middle pixel of 'psf_shape'
+std::vector<double> make_psf(double sigma){
+	std::vector<double> psf(du::product(psf_shape));
+	for(size_t y=0; y<psf_shape[1]; ++y){
+		for(size_t x=0; x<psf_shape[0]; ++x){
+			const double dx = double(x) - double(psf_shape[0]/2), dy = double(y) - double(psf_shape[1]/2);
+			psf[x + y*psf_shape[0]] = std::exp(-0.5*(dx*dx + dy*dy)/(sigma*sigma));
+		}
+	}
+	du::multiply_inplace(psf, 1.0/du::sum(psf));
+	return psf;
+}
+
+// Observation of a point source of 'flux' at pixel (x0, y0)
+std::vector<double> make_point_source(const std::vector<double>& psf, size_t x0, size_t y0, double flux){
+	std::vector<double> obs(du::product(obs_shape), 0.0);
+	for(size_t y=0; y<psf_shape[1]; ++y){
+		for(size_t x=0; x<psf_shape[0]; ++x){
+			obs[(x0 + x - psf_shape[0]/2) + (y0 + y - psf_shape[1]/2)*obs_shape[0]] += flux*psf[x + y*psf_shape[0]];
+		}
+	}
+	return obs;
+}
+
+// Two point sources with a little noise
+std::vector<double> make_noisy_sources(const std::vector<double>& psf){
+	std::vector<double> obs = make_point_source(psf, 20, 30, 50);
+	du::add_inplace(obs, make_point_source(psf, 40, 15, 20));
+	for(size_t i=0; i<obs.size(); ++i){
+		obs[i] += 0.01*std::sin(0.37*i);
+	}
+	return obs;
+}
+
+// Records are sized by the caller, as 'main.cpp' does
+template<class T>
+void prepare(CleanModifiedAlgorithm<T>& deconvolver, std::vector<double> obs, std::vector<double> psf){
+	deconvolver.fabs_record.assign(deconvolver.n_iter, NAN);
+	deconvolver.rms_record.assign(deconvolver.n_iter, NAN);
+	deconvolver.threshold_record.assign(deconvolver.n_iter, NAN);
+	std::vector<size_t> obs_shape_copy(obs_shape), psf_shape_copy(psf_shape);
+	deconvolver.prepare_observations(obs, obs_shape_copy, psf, psf_shape_copy);
+}
+
+// Runs 'deconvolver' on a point source, components should peak on the source's pixel (the
+// PSF is centred, so there is no offset), hold at least 'min_peak_fraction' of the flux
+// there, and add up to the source's flux
+template<class T>
+void check_point_source_recovered(CleanModifiedAlgorithm<T>& deconvolver, const std::string& name, double min_peak_fraction=0.999){
+	const size_t x0 = 20, y0 = 30;
+	const double flux = 50;
+	const std::vector<double> psf = make_psf(2.0);
+	prepare(deconvolver, make_point_source(psf, x0, y0, flux), psf);
+	deconvolver.run();
+
+	const std::vector<T>& components = deconvolver.components_data;
+	const size_t peak_idx = std::max_element(components.begin(), components.end()) - components.begin();
+	const double total = du::sum<T,double>(components);
+	check(peak_idx == x0 + y0*obs_shape[0], name + " component lands on the point source");
+	check(std::abs(total - flux) < 0.02*flux, _sprintf("% recovers the point source's flux, % of %", name, total, flux));
+	check(components[peak_idx] >= min_peak_fraction*total, _sprintf("% puts % of the flux in the source's pixel", name, components[peak_idx]/total));
+}
+
+void test_hogbom_point_source(){
+	HogbomCleanAlgorithm<double> hogbom(1000, 0, 0.1, 0.3, 0.0);
+	check_point_source_recovered(hogbom, "hogbom");
+}
+
+void test_clark_point_source(){
+	ClarkCleanAlgorithm<double> clark(1000, 0, 0.1, 0.3, 0.0);
+	check_point_source_recovered(clark, "clark");
+}
+
+void test_clark_empty_minor_cycle(){
+	// Major cycles without components cannot change the residual, the run must stop at once
+	ClarkCleanAlgorithm<double> clark(1000, 0, 0.1, 0.3, 0.0);
+	clark.clark_max_minor_iter = 0;
+	const std::vector<double> psf = make_psf(2.0);
+	prepare(clark, make_point_source(psf, 20, 30, 50), psf);
+	clark.run();
+	check((clark.n_iter_done == 1) && (du::absmax(clark.components_data) == 0), _sprintf("clark stops when its minor cycle finds nothing, after % iterations", clark.n_iter_done));
+}
+
+void test_multiscale_point_source(){
+	// The smallest scale is a point, larger scales should not win for a point source
+	MultiScaleCleanAlgorithm<double> multiscale(1000, 0, 0.1, 0.3, 0.0);
+	check_point_source_recovered(multiscale, "multiscale");
+}
+
+void test_multiscale_without_scales(){
+	MultiScaleCleanAlgorithm<double> multiscale(1000, 0, 0.1, 0.3, 0.0);
+	multiscale.multiscale_sigmas.clear();
+	const std::vector<double> psf = make_psf(2.0);
+	prepare(multiscale, make_point_source(psf, 20, 30, 50), psf);
+	check((multiscale.multiscale_sigmas == std::vector<double>{0}) && (multiscale.scale_residuals.size() == 1), "multiscale with no scales uses a point scale");
+}
+
+// Runs 'deconvolver' on two point sources with a little noise, its estimate must stay
+// non-negative and the residual must shrink over every 'window' iterations. Accelerated
+// methods can overshoot for an iteration or two, so they are given a longer window.
+template<class T>
+void check_non_negative_and_converging(CleanModifiedAlgorithm<T>& deconvolver, const std::string& name, size_t window=1){
+	const std::vector<double> psf = make_psf(2.0);
+	prepare(deconvolver, make_noisy_sources(psf), psf);
+	deconvolver.run();
+
+	const std::vector<T>& estimate = deconvolver.components_data;
+	check(*std::min_element(estimate.begin(), estimate.end()) >= 0, name + " estimate is non-negative");
+	const std::vector<double>& rms = deconvolver.rms_record;
+	const size_t n_done = deconvolver.n_iter_done;
+	size_t n_increases = 0;
+	for(size_t i=window; i<n_done; ++i){
+		n_increases += !(rms[i] < rms[i-window]);
+	}
+	check(rms[n_done-1] < 0.1*rms[0], _sprintf("% residual shrinks, rms % to %", name, rms[0], rms[n_done-1]));
+	check(n_increases == 0, _sprintf("% residual decreases over every % iterations, % exceptions", name, window, n_increases));
+}
+
+void test_richardson_lucy_non_negative(){
+	RichardsonLucyAlgorithm<double> richardson_lucy(100, 0, 0.1, 0.3, 0.0);
+	check_non_negative_and_converging(richardson_lucy, "richardson_lucy", 10);
+	RichardsonLucyAlgorithm<double> unaccelerated(100, 0, 0.1, 0.3, 0.0);
+	unaccelerated.richardson_lucy_acceleration = false;
+	check_non_negative_and_converging(unaccelerated, "unaccelerated richardson_lucy");
+}
+
+void test_fista_non_negative(){
+	// FISTA's momentum is not monotone either, adaptive restarts keep it from going far
+	FistaAlgorithm<double> fista(100, 0, 0.1, 0.3, 0.0);
+	check_non_negative_and_converging(fista, "fista", 10);
+	FistaAlgorithm<double> least_squares(100, 0, 0.1, 0.3, 0.0);
+	least_squares.fista_l1_weight = 0;
+	check_non_negative_and_converging(least_squares, "fista without L1", 10);
+}
+
+// Residual with a fraction 'bright_fraction' of its pixels spread over [9.5, 10.5] in
+// absolute value and the rest over [0.9, 1.1], of both signs
+std::vector<double> make_bimodal_residual(double bright_fraction){
+	std::vector<double> obs(du::product(obs_shape));
+	const size_t n_bright = bright_fraction*obs.size();
+	for(size_t i=0; i<obs.size(); ++i){
+		const double spread = double(i % 11)/10 - 0.5;
+		const double magnitude = (i % (obs.size()/n_bright) == 0) ? 10 + spread : 1 + 0.2*spread;
+		obs[i] = ((i/3) % 2) ? -magnitude : magnitude;
+	}
+	return obs;
+}
+
+void test_otsu_threshold(){
+	const std::vector<double> psf = make_psf(2.0);
+	for(double bright_fraction : {0.5, 0.2, 0.02}){
+		CleanModifiedAlgorithm<double> deconvolver(10, 0, 0.1, 0.0, 0.0);
+		prepare(deconvolver, make_bimodal_residual(bright_fraction), psf);
+		deconvolver._calc_pixel_threshold();
+		check((deconvolver.px_threshold > 1.1) && (deconvolver.px_threshold < 9.5), _sprintf("otsu threshold % separates the modes with % of the pixels bright", deconvolver.px_threshold, bright_fraction));
+	}
+
+	CleanModifiedAlgorithm<double> deconvolver(10, 0, 0.1, 0.0, 0.0);
+	prepare(deconvolver, std::vector<double>(du::product(obs_shape), 0.0), psf);
+	deconvolver._calc_pixel_threshold();
+	check(deconvolver.px_threshold == 0, "otsu threshold of an all zero residual is zero");
+}
+
+void test_clean_beam(){
+	// One unit component restored with a beam of standard deviation sigma is the unit-sum
+	// gaussian exp(-r^2/(2 sigma^2))/(2 pi sigma^2) centred on it
+	CleanModifiedAlgorithm<double> deconvolver(10, 0, 0.1, 0.3, 0.0);
+	const std::vector<double> psf = make_psf(2.0);
+	prepare(deconvolver, make_point_source(psf, 20, 30, 50), psf);
+	const size_t x0 = 20, y0 = 30;
+	std::fill(deconvolver.components_data.begin(), deconvolver.components_data.end(), 0.0);
+	deconvolver.components_data[x0 + y0*obs_shape[0]] = 1;
+
+	const double sigma = 2.5;
+	const std::vector<std::vector<double>> maps = deconvolver.restore_clean_maps({sigma, 0, 1.5});
+	const std::vector<double>& beam = maps[0];
+	double sum = 0, var_x = 0, var_y = 0;
+	for(size_t y=0; y<obs_shape[1]; ++y){
+		for(size_t x=0; x<obs_shape[0]; ++x){
+			const double v = beam[x + y*obs_shape[0]];
+			const double dx = double(x) - double(x0), dy = double(y) - double(y0);
+			sum += v;
+			var_x += v*dx*dx;
+			var_y += v*dy*dy;
+		}
+	}
+	const double peak = beam[x0 + y0*obs_shape[0]];
+	check(std::abs(sum - 1) < 1E-9, _sprintf("clean beam has unit sum, %", sum));
+	check(std::abs(peak - 1/(2*M_PI*sigma*sigma)) < 1E-9, _sprintf("clean beam peak % is 1/(2 pi sigma^2)", peak));
+	check((std::abs(std::sqrt(var_x/sum) - sigma) < 1E-6) && (std::abs(std::sqrt(var_y/sum) - sigma) < 1E-6), _sprintf("clean beam standard deviations %, % are sigma %", std::sqrt(var_x/sum), std::sqrt(var_y/sum), sigma));
+	check(maps[1] == deconvolver.components_data, "clean beam of zero sigma returns the components");
+
+	const std::vector<std::vector<double>> single = deconvolver.restore_clean_maps({1.5});
+	double max_diff = 0;
+	for(size_t k=0; k<single[0].size(); ++k){
+		max_diff = std::max(max_diff, std::abs(single[0][k] - maps[2][k]));
+	}
+	check(max_diff < 1E-15, _sprintf("extra clean beam matches restoring with it alone, max difference %", max_diff));
+}
+
+void test_preview(){
+	// "tiled" updates prepare no full-frame PSF spectrum for a run, the preview makes its own
+	HogbomCleanAlgorithm<double> hogbom(1000, 0, 0.1, 0.3, 0.0);
+	hogbom.update_mode = "tiled";
+	std::vector<double> psf = make_psf(2.0);
+	std::vector<double> obs = make_point_source(psf, 20, 30, 50);
+	std::vector<size_t> obs_shape_copy(obs_shape), psf_shape_copy(psf_shape);
+	hogbom.prepare_preview(obs, obs_shape_copy, psf, psf_shape_copy);
+	hogbom.preview();
+	const std::vector<double>& clean_map = hogbom.clean_map;
+	const size_t peak_idx = std::max_element(clean_map.begin(), clean_map.end()) - clean_map.begin();
+	check((clean_map.size() == du::product(obs_shape)) && (peak_idx == 20 + 30*obs_shape[0]), "preview peaks on the point source");
+}
+
+void test_preview_after_run_refused(){
+	HogbomCleanAlgorithm<double> hogbom(1000, 0, 0.1, 0.3, 0.0);
+	const std::vector<double> psf = make_psf(2.0);
+	prepare(hogbom, make_point_source(psf, 20, 30, 50), psf);
+	hogbom.run();
+	const std::vector<double> clean_map = hogbom.clean_map;
+	hogbom.preview();
+	check(hogbom.clean_map == clean_map, "preview after run leaves the clean map unchanged");
+}
+
+// Runs a 'D' uninterrupted, and another stopped after 'n_before' iterations, saved, and resumed
+// into a third whose run parameters differ, so must come from the checkpoint. The resumed
+// run must end as the uninterrupted one did.
+template<class D>
+void check_checkpoint_round_trip(const std::string& name, size_t n_iter, size_t n_before){
+	const std::vector<double> psf = make_psf(2.0);
+	const std::vector<double> obs = make_noisy_sources(psf);
+	D uninterrupted(n_iter, 0, 0.1, 0.3, 0.0);
+	prepare(uninterrupted, obs, psf);
+	uninterrupted.run();
+
+	D interrupted(n_iter, 0, 0.1, 0.3, 0.0);
+	prepare(interrupted, obs, psf);
+	interrupted.n_iter = n_before;
+	interrupted.run();
+	const std::vector<std::byte> checkpoint = interrupted.save_checkpoint();
+
+	D resumed(n_iter, 0, 0.5, 0.9, 0.0);
+	resumed.update_mode = "separable";
+	const bool resumed_ok = resumed.resume_from_checkpoint(checkpoint);
+	resumed.run();
+
+	const size_t n_done = uninterrupted.n_iter_done;
+	check(resumed_ok && (resumed.n_iter_done == n_done), _sprintf("% resumed after % iterations does %, as an uninterrupted run does", name, n_before, resumed.n_iter_done));
+	check((resumed.components_data == uninterrupted.components_data) && (resumed.residual_data == uninterrupted.residual_data), _sprintf("% resumed after % iterations has the components and residual of an uninterrupted run", name, n_before));
+	check(std::equal(uninterrupted.rms_record.begin(), uninterrupted.rms_record.begin() + n_done, resumed.rms_record.begin()), _sprintf("% resumed after % iterations has the records of an uninterrupted run", name, n_before));
+}
+
+void test_checkpoint_round_trip(){
+	check_checkpoint_round_trip<CleanModifiedAlgorithm<double>>("clean_modified", 100, 37);
+	check_checkpoint_round_trip<CleanModifiedAlgorithm<float>>("float clean_modified", 100, 37);
+	check_checkpoint_round_trip<HogbomCleanAlgorithm<double>>("hogbom", 200, 61);
+	check_checkpoint_round_trip<ClarkCleanAlgorithm<double>>("clark", 100, 2);
+	// Stops on its own criteria before this, the resumed run must not go on
+	check_checkpoint_round_trip<ClarkCleanAlgorithm<double>>("clark", 100, 30);
+}
+
+void test_checkpoint_rejected(){
+	const std::vector<double> psf = make_psf(2.0);
+	HogbomCleanAlgorithm<double> hogbom(10, 0, 0.1, 0.3, 0.0);
+	prepare(hogbom, make_noisy_sources(psf), psf);
+	hogbom.run();
+	const std::vector<std::byte> checkpoint = hogbom.save_checkpoint();
+
+	HogbomCleanAlgorithm<double> resumed;
+	check(resumed.resume_from_checkpoint(checkpoint), "undamaged checkpoint is accepted");
+
+	std::vector<std::byte> truncated(checkpoint.begin(), checkpoint.end()-1);
+	check(!resumed.resume_from_checkpoint(truncated), "truncated checkpoint is rejected");
+	check(!resumed.resume_from_checkpoint(std::span(checkpoint).first(sizeof(CheckpointHeader)-1)), "checkpoint without a whole header is rejected");
+
+	std::vector<std::byte> wrong_magic(checkpoint);
+	wrong_magic[0] ^= std::byte(1);
+	check(!resumed.resume_from_checkpoint(wrong_magic), "checkpoint with the wrong magic is rejected");
+
+	ClarkCleanAlgorithm<double> clark;
+	check(!clark.resume_from_checkpoint(checkpoint), "checkpoint of another type of deconvolver is rejected");
+	HogbomCleanAlgorithm<float> hogbom_float;
+	check(!hogbom_float.resume_from_checkpoint(checkpoint), "checkpoint of another precision is rejected");
+
+	// Sizes whose products and sums overflow must not pass for small ones
+	auto with_header = [&](const std::function<void(CheckpointHeader&)>& change){
+		CheckpointHeader header;
+		std::memcpy(&header, checkpoint.data(), sizeof(header));
+		change(header);
+		std::vector<std::byte> changed(checkpoint);
+		std::memcpy(changed.data(), &header, sizeof(header));
+		return changed;
+	};
+	check(!resumed.resume_from_checkpoint(with_header([](CheckpointHeader& header){header.data_shape[0] = uint64_t(1) << 62; header.data_shape[1] = 4;})), "checkpoint with an overflowing frame size is rejected");
+	check(!resumed.resume_from_checkpoint(with_header([](CheckpointHeader& header){header.n_iter_done = (uint64_t(1) << 61) + 1;})), "checkpoint with an overflowing record size is rejected");
+	check(!resumed.resume_from_checkpoint(with_header([](CheckpointHeader& header){header.psf_shape[0] = header.data_shape[0] + 1; header.psf_shape[1] = 1;})), "checkpoint with a PSF larger than its frame is rejected");
+}
+
+int main(int argc, char** argv){
+	INIT_LOGGING("WARN");
+
+	test_hogbom_point_source();
+	test_clark_point_source();
+	test_clark_empty_minor_cycle();
+	test_multiscale_point_source();
+	test_multiscale_without_scales();
+	test_richardson_lucy_non_negative();
+	test_fista_non_negative();
+	test_otsu_threshold();
+	test_clean_beam();
+	test_preview();
+	test_preview_after_run_refused();
+	test_checkpoint_round_trip();
+	test_checkpoint_rejected();
+
+	std::cout << n_failures << " failures" << std::endl;
+	return n_failures;
+}
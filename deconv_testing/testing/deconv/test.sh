@@ -0,0 +1,57 @@
+#!/bin/bash
+# Deconvolvers call into emscripten (e.g., 'emscripten_sleep()'), so this test is built with
+# em++ against the wasm build of FFTW in '${src_dir}/lib' and run with node
+
+
+repos_dir="${REPOS_DIR:-"${HOME}/repos"}"
+emscripten_repo="${repos_dir}/emsdk"
+this_dir=$(readlink -f $(dirname ${BASH_SOURCE}))
+src_dir="${this_dir}/../../"
+
+l_dirs=(
+	-L ~/usr/lib 
+	-L ${src_dir}/lib
+)
+i_dirs=(
+	-I ~/Documents/code/cpp_code/include 
+	-I ~/usr/include 
+	-I ${src_dir}/include 
+	-I ${src_dir}
+)
+cxx_flags=(
+	-O3 
+	-D LOGGING_ENABLED=false 
+	-sASYNCIFY 
+	-sENVIRONMENT=node 
+	-sINITIAL_HEAP=262144000 
+	-sNO_DISABLE_EXCEPTION_CATCHING 
+	${l_dirs[@]} 
+	${i_dirs[@]} 
+	-lfftw3f 
+	-lfftw3 
+	-lm 
+	-lembind 
+	-std=gnu++20
+)
+
+if [[ -z "${EMSDK}" ]]; then
+	export EMSDK_QUIET=1 # suppress EMSDK source output
+	source ${emscripten_repo}/emsdk_env.sh
+fi
+
+em++ -o test_bin.js  test.cpp ${src_dir}/deconv.cpp ${src_dir}/fft.cpp ${src_dir}/tiled_convolver.cpp ${src_dir}/separable_convolver.cpp ${src_dir}/tile_max_pyramid.cpp ${src_dir}/psf_cache.cpp ${src_dir}/storage.cpp ${src_dir}/image.cpp ${src_dir}/file_like.cpp ${src_dir}/data_utils.cpp ${src_dir}/str_printf.cpp ${cxx_flags[@]}
+
+compilation_failed=$?
+
+if [ ${compilation_failed} == 1 ]; then
+	echo "######################"
+	echo "# COMPILATION FAILED #"
+	echo "######################"
+	exit
+else
+	echo "########################"
+	echo "# COMPILATION COMPLETE #"
+	echo "########################"
+fi
+
+node test_bin.js
@@ -0,0 +1,455 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "logging.h"
+#include "data_utils.hpp"
+#include "fft.hpp"
+#include "tiled_convolver.hpp"
+#include "separable_convolver.hpp"
+#include "tile_max_pyramid.hpp"
+
+namespace du = data_utils;
+
+using complex = FourierTransformer<>::complex;
+
+int n_failures = 0;
+
+void check(bool result, const std::string& msg){
+	std::cout << (result ? "PASS: " : "FAIL: ") << msg << std::endl;
+	if(!result) ++n_failures;
+}
+
+double max_abs_diff(const std::vector<double>& a, const std::vector<double>& b){
+	double m = 0;
+	for(size_t i=0; i<a.size(); ++i){
+		m = std::max(m, std::abs(a[i]-b[i]));
+	}
+	return m;
+}
+
+std::vector<double> make_test_data(const std::vector<size_t>& shape){
+	std::vector<double> a(du::product(shape));
+	for(size_t i=0; i<a.size(); ++i){
+		a[i] = std::sin(0.37*i) + 0.01*(i%7);
+	}
+	return a;
+}
+
+void test_real_matches_complex(const std::vector<size_t>& shape){
+	std::vector<double> a = make_test_data(shape);
+
+	FourierTransformer c2c(shape, false, PlanRigor::ESTIMATE, false);
+	FourierTransformer r2c(shape, false, PlanRigor::ESTIMATE, true);
+
+	std::vector<complex> full = c2c(a);
+	std::vector<complex> half = r2c(a);
+
+	// Compare the non-redundant half of the full spectrum with the r2c result,
+	// data_shape is {x,y} so the x-axis (fastest varying) is the halved one.
+	size_t nx = shape[0], ny = shape[1], nhx = nx/2+1;
+	check(half.size() == nhx*ny, "r2c spectrum has (nx/2+1)*ny elements");
+	double m = 0;
+	for(size_t j=0; j<ny; ++j){
+		for(size_t i=0; i<nhx; ++i){
+			m = std::max(m, std::abs(full[j*nx + i] - half[j*nhx + i]));
+		}
+	}
+	check(m < 1E-9, _sprintf("r2c spectrum matches c2c spectrum for shape %x%", nx, ny));
+
+	FourierTransformer c2r(shape, true, PlanRigor::ESTIMATE, true);
+	check(max_abs_diff(c2r.real_output(half), a) < 1E-12, _sprintf("c2r(r2c(a)) == a for shape %x%", nx, ny));
+}
+
+void test_plan_cache(){
+	FFTPlanCache::clear();
+
+	std::vector<size_t> shape{16, 12};
+	FourierTransformer a(shape, false, PlanRigor::MEASURE, true);
+	size_t n_plans = FFTPlanCache::size();
+	FourierTransformer b(shape, false, PlanRigor::MEASURE, true);
+	check(FFTPlanCache::size() == n_plans, "second transformer of the same shape re-uses the cached plan");
+
+	// a less rigorous plan is satisfied by the more rigorous one already cached
+	FourierTransformer c(shape, false, PlanRigor::ESTIMATE, true);
+	check(FFTPlanCache::size() == n_plans, "estimate plan is satisfied by cached measure plan");
+
+	// copies move the buffers, they must still give the same result as the original
+	std::vector<double> data = make_test_data(shape);
+	std::vector<complex> expected = a(data);
+	FourierTransformer d(a);
+	std::vector<complex> result = d(data);
+	double m = 0;
+	for(size_t i=0; i<result.size(); ++i){
+		m = std::max(m, std::abs(result[i] - expected[i]));
+	}
+	check(m == 0, "copied transformer gives identical result");
+
+	// transformers keep their plans alive when the cache lets go of them
+	FFTPlanCache::clear();
+	check(FFTPlanCache::size() == 0, "clear empties the cache");
+	result = a(data);
+	m = 0;
+	for(size_t i=0; i<result.size(); ++i){
+		m = std::max(m, std::abs(result[i] - expected[i]));
+	}
+	check(m == 0, "transformer still works after the cache is cleared");
+
+	check(FFTPlanCache::export_wisdom().size() > 0, "wisdom can be exported");
+}
+
+void test_execute_on_caller_buffers(){
+	std::vector<size_t> shape{10, 7};
+	std::vector<double> data = make_test_data(shape);
+
+	FourierTransformer fft(shape, false, PlanRigor::ESTIMATE, true);
+	FourierTransformer ifft(shape, true, PlanRigor::ESTIMATE, true);
+
+	std::vector<complex> expected = fft(data);
+
+	// offset by one element so the buffers are not aligned the same way as the plan
+	std::vector<double> shifted_data(data.size()+1);
+	std::copy(data.begin(), data.end(), shifted_data.begin()+1);
+	std::vector<complex> spectrum(fft.spectrum_size);
+	fft.execute(std::span<const double>(shifted_data.data()+1, data.size()), spectrum);
+
+	double m = 0;
+	for(size_t i=0; i<spectrum.size(); ++i){
+		m = std::max(m, std::abs(spectrum[i] - expected[i]));
+	}
+	check(m < 1E-12, "execute() on misaligned caller buffer matches operator()");
+
+	std::vector<double> result(data.size());
+	ifft.execute(spectrum, result);
+	du::multiply_inplace(result, 1.0/data.size());
+	check(max_abs_diff(result, data) < 1E-12, "execute() round trip recovers input after normalisation");
+}
+
+std::vector<double> direct_circular_convolve(const std::vector<double>& a, const std::vector<double>& k, const std::vector<size_t>& shape){
+	size_t nx = shape[0], ny = shape[1];
+	std::vector<double> r(a.size(), 0);
+	for(size_t y=0; y<ny; ++y){
+		for(size_t x=0; x<nx; ++x){
+			for(size_t v=0; v<ny; ++v){
+				for(size_t u=0; u<nx; ++u){
+					r[((y+v)%ny)*nx + (x+u)%nx] += a[y*nx+x]*k[v*nx+u];
+				}
+			}
+		}
+	}
+	return r;
+}
+
+void test_convolve(){
+	std::vector<size_t> shape{9, 6};
+	std::vector<double> data = make_test_data(shape);
+	std::vector<double> kernel(data.size(), 0);
+	kernel[0] = 0.5;
+	kernel[1] = 0.25;
+	kernel[shape[0]] = 0.25;
+	kernel[data.size()-1] = 0.1;
+
+	FourierTransformer fft(shape, false, PlanRigor::ESTIMATE, true);
+	FourierTransformer ifft(shape, true, PlanRigor::ESTIMATE, true);
+
+	std::vector<complex> kernel_fft(fft.spectrum_size), data_fft(fft.spectrum_size);
+	fft.execute(kernel, kernel_fft);
+	ifft.normalise_spectrum(kernel_fft);
+	fft.execute(data, data_fft);
+	std::vector<complex> data_fft_copy(data_fft);
+
+	std::vector<double> result(data.size());
+	ifft.convolve(data_fft, kernel_fft, result);
+
+	check(max_abs_diff(result, direct_circular_convolve(data, kernel, shape)) < 1E-12, "convolve() matches direct circular convolution");
+	check(data_fft == data_fft_copy, "convolve() does not modify its input spectrum");
+}
+
+void test_symmetric_convolve(){
+	std::vector<size_t> shape{9, 6};
+	std::vector<double> data = make_test_data(shape);
+	// symmetric under (x,y) -> (-x,-y), so its spectrum is real
+	std::vector<double> kernel(data.size(), 0);
+	kernel[0] = 0.5;
+	kernel[1] = kernel[shape[0]-1] = 0.2;
+	kernel[shape[0]] = kernel[data.size()-shape[0]] = 0.15;
+	kernel[shape[0]+1] = kernel[data.size()-1] = 0.05;
+
+	FourierTransformer fft(shape, false, PlanRigor::ESTIMATE, true);
+	FourierTransformer ifft(shape, true, PlanRigor::ESTIMATE, true);
+
+	std::vector<complex> kernel_fft(fft.spectrum_size), data_fft(fft.spectrum_size);
+	fft.execute(kernel, kernel_fft);
+	ifft.normalise_spectrum(kernel_fft);
+	std::vector<double> kernel_fft_real(fft.spectrum_size);
+	for(size_t i=0; i<kernel_fft.size(); ++i){
+		kernel_fft_real[i] = kernel_fft[i].real();
+	}
+	fft.execute(data, data_fft);
+
+	std::vector<double> result(data.size());
+	ifft.convolve(data_fft, kernel_fft_real, result);
+
+	check(max_abs_diff(result, direct_circular_convolve(data, kernel, shape)) < 1E-12, "convolve() with a real kernel spectrum matches direct circular convolution");
+}
+
+void test_tiled_convolve(){
+	// several tiles along each axis, with the kernel support wrapping around the frame edges
+	std::vector<size_t> shape{37, 23}, kernel_shape{5, 4}, kernel_offset{2, 1};
+	std::vector<double> data = make_test_data(shape);
+	// leave the middle of the frame empty so some tiles are skipped
+	for(size_t y=8; y<16; ++y){
+		for(size_t x=0; x<shape[0]; ++x){
+			data[y*shape[0] + x] = 0;
+		}
+	}
+	std::vector<double> kernel = make_test_data(kernel_shape);
+
+	// the same kernel embedded in a full frame, with its origin on pixel 0
+	std::vector<double> full_kernel(data.size(), 0);
+	for(size_t j=0; j<kernel_shape[1]; ++j){
+		for(size_t i=0; i<kernel_shape[0]; ++i){
+			size_t x = (i + shape[0] - kernel_offset[0]) % shape[0];
+			size_t y = (j + shape[1] - kernel_offset[1]) % shape[1];
+			full_kernel[y*shape[0] + x] = kernel[j*kernel_shape[0] + i];
+		}
+	}
+
+	TiledConvolver convolver;
+	convolver.set_kernel(shape, kernel, kernel_shape, kernel_offset, 8);
+	std::vector<double> result(data.size());
+	convolver.convolve(data, result);
+
+	size_t n_tiles = ((shape[0]+convolver.block_shape[0]-1)/convolver.block_shape[0])*((shape[1]+convolver.block_shape[1]-1)/convolver.block_shape[1]);
+	check(convolver.n_tiles_transformed < n_tiles, "tiled convolution skips empty tiles");
+	check(max_abs_diff(result, direct_circular_convolve(data, full_kernel, shape)) < 1E-12, "tiled convolution matches direct circular convolution");
+}
+
+void test_separable_convolve(){
+	std::vector<size_t> shape{23, 17}, kernel_shape{7, 5}, kernel_offset{3, 1};
+	std::vector<double> data = make_test_data(shape);
+	for(size_t y=4; y<9; ++y){
+		for(size_t x=0; x<shape[0]; ++x){
+			data[y*shape[0] + x] = 0;
+		}
+	}
+	// sum of two separable terms, so exactly rank 2
+	std::vector<double> kernel(du::product(kernel_shape));
+	for(size_t j=0; j<kernel_shape[1]; ++j){
+		for(size_t i=0; i<kernel_shape[0]; ++i){
+			kernel[j*kernel_shape[0] + i] = std::exp(-0.3*(i-3.0)*(i-3.0) - 0.5*(j-1.0)*(j-1.0)) + 0.2*std::cos(double(i))*std::sin(1.0+j);
+		}
+	}
+
+	std::vector<double> full_kernel(data.size(), 0);
+	for(size_t j=0; j<kernel_shape[1]; ++j){
+		for(size_t i=0; i<kernel_shape[0]; ++i){
+			size_t x = (i + shape[0] - kernel_offset[0]) % shape[0];
+			size_t y = (j + shape[1] - kernel_offset[1]) % shape[1];
+			full_kernel[y*shape[0] + x] = kernel[j*kernel_shape[0] + i];
+		}
+	}
+	std::vector<double> expected = direct_circular_convolve(data, full_kernel, shape);
+
+	SeparableConvolver convolver;
+	std::vector<double> result(data.size());
+	convolver.set_kernel(shape, kernel, kernel_shape, kernel_offset, 1E-9);
+	convolver.convolve(data, result);
+	check(convolver.rank == 2, "separable convolution keeps the rank of the kernel");
+	check(max_abs_diff(result, expected) < 1E-12, "separable convolution matches direct circular convolution");
+
+	// a loose error bound keeps only the first term
+	convolver.set_kernel(shape, kernel, kernel_shape, kernel_offset, 0.5);
+	convolver.convolve(data, result);
+	check((convolver.rank == 1) && (convolver.relative_error <= 0.5), "separable convolution truncates to the error bound");
+}
+
+void test_tile_max_pyramid(){
+	// tiles do not divide the frame, so edge tiles are smaller
+	std::vector<size_t> shape{37, 23};
+	std::vector<double> data = make_test_data(shape);
+	TileMaxPyramid pyramid;
+	pyramid.set_shape(shape, 8);
+	pyramid.refresh(data);
+
+	auto check_against_scan = [&](const std::string& msg){
+		double sum_of_squares = 0;
+		size_t idx_absmax = 0;
+		for(size_t idx=0; idx<data.size(); ++idx){
+			sum_of_squares += data[idx]*data[idx];
+			idx_absmax = (std::fabs(data[idx]) > std::fabs(data[idx_absmax])) ? idx : idx_absmax;
+		}
+		check(
+			(pyramid.absmax() == data[idx_absmax]) 
+			&& (pyramid.argmax(data) == idx_absmax)
+			&& (std::fabs(pyramid.sum_of_squares() - sum_of_squares) < 1E-9*sum_of_squares),
+			msg
+		);
+	};
+	check_against_scan("tile max pyramid matches a full scan");
+
+	// change a rectangle that wraps around the corner of the frame, and refresh only the tiles it touches
+	std::vector<size_t> offset{33, 20}, box{6, 5};
+	for(size_t j=0; j<box[1]; ++j){
+		for(size_t i=0; i<box[0]; ++i){
+			data[((offset[1]+j)%shape[1])*shape[0] + (offset[0]+i)%shape[0]] = -3.0*(i+j+1);
+		}
+	}
+	std::vector<size_t> tiles = pyramid.tiles_overlapping(offset, box);
+	check(tiles.size() == 4, "tiles overlapping a box wrap around the frame");
+	for(size_t k : tiles){
+		pyramid.refresh_tile(k, data);
+	}
+	pyramid.update_levels();
+	check_against_scan("tile max pyramid matches a full scan after refreshing touched tiles");
+
+	std::vector<size_t> above = pyramid.tiles_above(10);
+	bool all_found = true;
+	for(size_t idx=0; idx<data.size(); ++idx){
+		if (std::fabs(data[idx]) > 10){
+			const size_t k = (idx % shape[0])/8 + ((idx / shape[0])/8)*pyramid.level_shapes[0][0];
+			all_found &= std::find(above.begin(), above.end(), k) != above.end();
+		}
+	}
+	check(all_found && (above.size() < pyramid.levels[0].size()), "tiles above a threshold hold every value above it");
+}
+
+void test_batched_convolve(){
+	// three arrays one after another, as the planar layers of an RGB image
+	std::vector<size_t> shape{9, 6};
+	const size_t n_batch = 3;
+	const size_t n = du::product(shape);
+	std::vector<double> data = make_test_data({n, n_batch});
+	std::vector<double> kernel(data.size(), 0);
+	for(size_t k=0; k<n_batch; ++k){
+		kernel[k*n] = 0.5;
+		kernel[k*n + 1 + k] = 0.25;
+	}
+
+	FourierTransformer fft(shape, false, PlanRigor::ESTIMATE, true, 1, n_batch);
+	FourierTransformer ifft(shape, true, PlanRigor::ESTIMATE, true, 1, n_batch);
+
+	std::vector<complex> kernel_fft(n_batch*fft.spectrum_size), data_fft(n_batch*fft.spectrum_size);
+	fft.execute(kernel, kernel_fft);
+	ifft.normalise_spectrum(kernel_fft);
+	fft.execute(data, data_fft);
+
+	std::vector<double> result(data.size());
+	ifft.convolve(data_fft, kernel_fft, result);
+
+	double m = 0;
+	for(size_t k=0; k<n_batch; ++k){
+		std::vector<double> a(data.begin()+k*n, data.begin()+(k+1)*n);
+		std::vector<double> b(kernel.begin()+k*n, kernel.begin()+(k+1)*n);
+		std::vector<double> r(result.begin()+k*n, result.begin()+(k+1)*n);
+		m = std::max(m, max_abs_diff(r, direct_circular_convolve(a, b, shape)));
+	}
+	check(m < 1E-12, "batched convolve() matches direct circular convolution of each array");
+
+	// one kernel spectrum shared by the whole batch
+	ifft.convolve(data_fft, std::span<const complex>(kernel_fft.data(), fft.spectrum_size), result);
+	m = 0;
+	for(size_t k=0; k<n_batch; ++k){
+		std::vector<double> a(data.begin()+k*n, data.begin()+(k+1)*n);
+		std::vector<double> b(kernel.begin(), kernel.begin()+n);
+		std::vector<double> r(result.begin()+k*n, result.begin()+(k+1)*n);
+		m = std::max(m, max_abs_diff(r, direct_circular_convolve(a, b, shape)));
+	}
+	check(m < 1E-12, "batched convolve() with a shared kernel matches direct circular convolution");
+}
+
+void test_single_precision(){
+	std::vector<size_t> shape{9, 6};
+	std::vector<double> data = make_test_data(shape);
+	std::vector<double> kernel(data.size(), 0);
+	kernel[0] = 0.5;
+	kernel[1] = 0.25;
+	kernel[data.size()-1] = 0.1;
+
+	FourierTransformer<float> fft(shape, false, PlanRigor::ESTIMATE, true);
+	FourierTransformer<float> ifft(shape, true, PlanRigor::ESTIMATE, true);
+
+	std::vector<float> data_f = du::as_type<float>(data), result_f(data.size());
+	std::vector<FourierTransformer<float>::complex> kernel_fft(fft.spectrum_size), data_fft(fft.spectrum_size);
+	fft.execute(du::as_type<float>(kernel), kernel_fft);
+	ifft.normalise_spectrum(kernel_fft);
+	fft.execute(data_f, data_fft);
+	ifft.convolve(data_fft, kernel_fft, result_f);
+
+	check(max_abs_diff(du::as_type<double>(result_f), direct_circular_convolve(data, kernel, shape)) < 1E-5, "single precision convolve() matches direct circular convolution");
+	check(FFTPlanCache::export_wisdom<float>() != FFTPlanCache::export_wisdom<double>(), "single and double precision wisdom are separate");
+}
+
+void test_mixed_radix_matches_fftw(const std::vector<size_t>& shape, size_t n_batch){
+	set_fft_backend(FFTBackend::FFTW);
+	FourierTransformer<> fftw_r2c(shape, false, PlanRigor::ESTIMATE, true, 1, n_batch);
+	FourierTransformer<> fftw_c2r(shape, true, PlanRigor::ESTIMATE, true, 1, n_batch);
+	FourierTransformer<> fftw_c2c(shape, false, PlanRigor::ESTIMATE, false, 1, n_batch);
+	set_fft_backend(FFTBackend::MIXED_RADIX);
+	FourierTransformer<> mixed_r2c(shape, false, PlanRigor::ESTIMATE, true, 1, n_batch);
+	FourierTransformer<> mixed_c2r(shape, true, PlanRigor::ESTIMATE, true, 1, n_batch);
+	FourierTransformer<> mixed_c2c(shape, false, PlanRigor::ESTIMATE, false, 1, n_batch);
+	set_fft_backend(FFTBackend::AUTO);
+	check((fftw_r2c.backend == FFTBackend::FFTW) && (mixed_r2c.backend == FFTBackend::MIXED_RADIX), "transformers use the backend set when they are planned");
+
+	const std::vector<double> data = make_test_data({n_batch*shape[0], shape[1]});
+	std::vector<complex> fftw_spectrum(n_batch*fftw_r2c.spectrum_size), mixed_spectrum(n_batch*mixed_r2c.spectrum_size);
+	fftw_r2c.execute(data, fftw_spectrum);
+	mixed_r2c.execute(data, mixed_spectrum);
+	double m = 0;
+	for(size_t i=0; i<fftw_spectrum.size(); ++i){
+		m = std::max(m, std::abs(fftw_spectrum[i] - mixed_spectrum[i]));
+	}
+	check(m < 1E-10, _sprintf("mixed radix r2c matches FFTW for shape %x% batches %", shape[0], shape[1], n_batch));
+
+	std::vector<double> fftw_result(data.size()), mixed_result(data.size());
+	fftw_c2r.execute(fftw_spectrum, fftw_result);
+	mixed_c2r.execute(mixed_spectrum, mixed_result);
+	check(max_abs_diff(fftw_result, mixed_result) < 1E-10, _sprintf("mixed radix c2r matches FFTW for shape %x% batches %", shape[0], shape[1], n_batch));
+
+	std::vector<complex> complex_data(data.size()), fftw_c2c_result(data.size()), mixed_c2c_result(data.size());
+	for(size_t i=0; i<data.size(); ++i){
+		complex_data[i] = complex(data[i], data[data.size()-1-i]);
+	}
+	fftw_c2c.execute(complex_data, fftw_c2c_result);
+	mixed_c2c.execute(complex_data, mixed_c2c_result);
+	m = 0;
+	for(size_t i=0; i<complex_data.size(); ++i){
+		m = std::max(m, std::abs(fftw_c2c_result[i] - mixed_c2c_result[i]));
+	}
+	check(m < 1E-10, _sprintf("mixed radix c2c matches FFTW for shape %x% batches %", shape[0], shape[1], n_batch));
+}
+
+void test_auto_backend_skips_large_primes(){
+	check(MixedRadixFFT<>::largest_prime_factor({26, 12}) == 13, "largest prime factor of 26x12 is 13");
+	check(MixedRadixFFT<>::largest_prime_factor({35, 16}) == 7, "largest prime factor of 35x16 is 7");
+
+	set_fft_backend(FFTBackend::AUTO);
+	FourierTransformer<> r2c({26, 22}, false, PlanRigor::ESTIMATE, true);
+	check(r2c.backend == FFTBackend::FFTW, "automatic backend selection uses FFTW for prime factors above 7");
+}
+
+int main(int argc, char** argv){
+	INIT_LOGGING("WARN");
+
+	test_real_matches_complex({8, 6});
+	test_real_matches_complex({9, 7});
+	test_real_matches_complex({65, 49});
+	test_plan_cache();
+	test_execute_on_caller_buffers();
+	test_convolve();
+	test_symmetric_convolve();
+	test_tiled_convolve();
+	test_separable_convolve();
+	test_tile_max_pyramid();
+	test_batched_convolve();
+	test_single_precision();
+	test_mixed_radix_matches_fftw({8, 6}, 1);
+	test_mixed_radix_matches_fftw({25, 12}, 3);
+	test_mixed_radix_matches_fftw({13, 11}, 2);
+	test_auto_backend_skips_large_primes();
+
+	std::cout << n_failures << " failures" << std::endl;
+	return n_failures;
+}
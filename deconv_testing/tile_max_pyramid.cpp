@@ -0,0 +1,222 @@
+#include "tile_max_pyramid.hpp"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+
+template<class T>
+TileMaxPyramid<T>::TileMaxPyramid()
+	: data_shape()
+	, tile_shape()
+	, level_shapes()
+	, levels()
+	, dirty_tiles()
+	, is_dirty()
+{}
+
+template<class T>
+void TileMaxPyramid<T>::set_shape(const std::vector<size_t>& _data_shape, const size_t tile_size){
+	GET_LOGGER;
+	assert(_data_shape.size() == 2);
+	data_shape = _data_shape;
+	tile_shape = {std::min(tile_size, data_shape[0]), std::min(tile_size, data_shape[1])};
+
+	level_shapes.clear();
+	level_shapes.push_back({
+		(data_shape[0] + tile_shape[0] - 1)/tile_shape[0],
+		(data_shape[1] + tile_shape[1] - 1)/tile_shape[1]
+	});
+	while (du::product(level_shapes.back()) > 1){
+		const std::vector<size_t>& below = level_shapes.back();
+		level_shapes.push_back({(below[0] + 1)/2, (below[1] + 1)/2});
+	}
+
+	levels.resize(level_shapes.size());
+	is_dirty.resize(level_shapes.size());
+	for(size_t l=0; l<levels.size(); ++l){
+		levels[l].assign(du::product(level_shapes[l]), Node{0, 0, 0});
+		is_dirty[l].assign(levels[l].size(), false);
+	}
+	dirty_tiles.clear();
+	LOGV_DEBUG(data_shape, tile_shape, level_shapes.size());
+}
+
+template<class T>
+std::array<size_t,2> TileMaxPyramid<T>::tile_offset(size_t k) const {
+	return {(k % level_shapes[0][0])*tile_shape[0], (k / level_shapes[0][0])*tile_shape[1]};
+}
+
+template<class T>
+std::array<size_t,2> TileMaxPyramid<T>::tile_extent(size_t k) const {
+	const std::array<size_t,2> offset = tile_offset(k);
+	return {std::min(tile_shape[0], data_shape[0] - offset[0]), std::min(tile_shape[1], data_shape[1] - offset[1])};
+}
+
+template<class T>
+void TileMaxPyramid<T>::refresh(std::span<const T> data){
+	for(size_t k=0; k<levels[0].size(); ++k){
+		refresh_tile(k, data);
+	}
+	update_levels();
+}
+
+template<class T>
+void TileMaxPyramid<T>::refresh_tile(size_t k, std::span<const T> data){
+	assert(data.size() == du::product(data_shape));
+	const size_t nx = data_shape[0];
+	const std::array<size_t,2> offset = tile_offset(k);
+	const std::array<size_t,2> extent = tile_extent(k);
+
+	// Extremes rather than the absolute value so the loop vectorises
+	T max_value = std::numeric_limits<T>::lowest();
+	T min_value = std::numeric_limits<T>::max();
+	double sum_of_squares = 0;
+	for(size_t y=offset[1]; y<offset[1]+extent[1]; ++y){
+		const T* row = data.data() + y*nx;
+		for(size_t x=offset[0]; x<offset[0]+extent[0]; ++x){
+			max_value = std::max(max_value, row[x]);
+			min_value = std::min(min_value, row[x]);
+			const T v2 = row[x]*row[x];
+			sum_of_squares += v2;
+		}
+	}
+	set_tile(k, max_value, min_value, sum_of_squares);
+}
+
+template<class T>
+void TileMaxPyramid<T>::set_tile(size_t k, T max_value, T min_value, double sum_of_squares){
+	levels[0][k] = Node{(max_value >= -min_value) ? max_value : min_value, k, sum_of_squares};
+	if (!is_dirty[0][k]){
+		is_dirty[0][k] = true;
+		dirty_tiles.push_back(k);
+	}
+}
+
+template<class T>
+void TileMaxPyramid<T>::update_levels(){
+	std::vector<size_t> dirty = std::move(dirty_tiles);
+	dirty_tiles.clear();
+	for(size_t k : dirty){
+		is_dirty[0][k] = false;
+	}
+
+	for(size_t l=1; l<levels.size(); ++l){
+		const std::vector<size_t>& below_shape = level_shapes[l-1];
+		const std::vector<size_t>& shape = level_shapes[l];
+
+		// Parents of the nodes that changed on the level below
+		std::vector<size_t> parents;
+		for(size_t k : dirty){
+			const size_t p = (k % below_shape[0])/2 + ((k / below_shape[0])/2)*shape[0];
+			if (!is_dirty[l][p]){
+				is_dirty[l][p] = true;
+				parents.push_back(p);
+			}
+		}
+
+		for(size_t p : parents){
+			is_dirty[l][p] = false;
+			const size_t px = p % shape[0], py = p / shape[0];
+			Node node{0, 0, 0};
+			bool is_first = true;
+			for(size_t cy=2*py; cy<std::min(2*py+2, below_shape[1]); ++cy){
+				for(size_t cx=2*px; cx<std::min(2*px+2, below_shape[0]); ++cx){
+					const Node& child = levels[l-1][cx + cy*below_shape[0]];
+					if (is_first || (std::abs(child.value) > std::abs(node.value))){
+						node.value = child.value;
+						node.tile = child.tile;
+						is_first = false;
+					}
+					node.sum_of_squares += child.sum_of_squares;
+				}
+			}
+			levels[l][p] = node;
+		}
+		dirty = std::move(parents);
+	}
+}
+
+template<class T>
+std::vector<size_t> TileMaxPyramid<T>::tiles_overlapping(const std::vector<size_t>& offset, const std::vector<size_t>& shape) const {
+	// Which columns and rows of tiles the (wrapping) rectangle crosses
+	std::vector<std::vector<bool>> crossed(2);
+	for(size_t a=0; a<2; ++a){
+		crossed[a].assign(level_shapes[0][a], false);
+		const size_t n = std::min(shape[a], data_shape[a]);
+		size_t i = offset[a] % data_shape[a];
+		for(size_t j=0; j<n; ++j){
+			crossed[a][i/tile_shape[a]] = true;
+			i = (i+1 == data_shape[a]) ? 0 : i+1;
+		}
+	}
+
+	std::vector<size_t> tiles;
+	for(size_t ty=0; ty<level_shapes[0][1]; ++ty){
+		if (!crossed[1][ty]){
+			continue;
+		}
+		for(size_t tx=0; tx<level_shapes[0][0]; ++tx){
+			if (crossed[0][tx]){
+				tiles.push_back(tx + ty*level_shapes[0][0]);
+			}
+		}
+	}
+	return tiles;
+}
+
+template<class T>
+std::vector<size_t> TileMaxPyramid<T>::tiles_above(T threshold) const {
+	std::vector<size_t> tiles;
+	// Nodes to visit as {level, index}, a node whose maximum is not above the threshold
+	// has nothing above it in any of its descendents.
+	std::vector<std::pair<size_t, size_t>> to_visit{{levels.size()-1, 0}};
+	while (!to_visit.empty()){
+		const auto [l, k] = to_visit.back();
+		to_visit.pop_back();
+		if (!(std::abs(levels[l][k].value) > threshold)){
+			continue;
+		}
+		if (l == 0){
+			tiles.push_back(k);
+			continue;
+		}
+		const std::vector<size_t>& below_shape = level_shapes[l-1];
+		const size_t px = k % level_shapes[l][0], py = k / level_shapes[l][0];
+		for(size_t cy=2*py; cy<std::min(2*py+2, below_shape[1]); ++cy){
+			for(size_t cx=2*px; cx<std::min(2*px+2, below_shape[0]); ++cx){
+				to_visit.push_back({l-1, cx + cy*below_shape[0]});
+			}
+		}
+	}
+	std::sort(tiles.begin(), tiles.end());
+	return tiles;
+}
+
+template<class T>
+T TileMaxPyramid<T>::absmax() const {
+	return levels.back()[0].value;
+}
+
+template<class T>
+size_t TileMaxPyramid<T>::argmax(std::span<const T> data) const {
+	const size_t nx = data_shape[0];
+	const Node& root = levels.back()[0];
+	const std::array<size_t,2> offset = tile_offset(root.tile);
+	const std::array<size_t,2> extent = tile_extent(root.tile);
+	for(size_t y=offset[1]; y<offset[1]+extent[1]; ++y){
+		const T* row = data.data() + y*nx;
+		const T* found = std::find(row + offset[0], row + offset[0] + extent[0], root.value);
+		if (found != row + offset[0] + extent[0]){
+			return (found - row) + y*nx;
+		}
+	}
+	return offset[0] + offset[1]*nx;
+}
+
+template<class T>
+double TileMaxPyramid<T>::sum_of_squares() const {
+	return levels.back()[0].sum_of_squares;
+}
+
+template class TileMaxPyramid<double>;
+template class TileMaxPyramid<float>;
@@ -0,0 +1,73 @@
+#ifndef __TILE_MAX_PYRAMID_INCLUDED__
+#define __TILE_MAX_PYRAMID_INCLUDED__
+
+#include <vector>
+#include <array>
+#include <span>
+#include "data_utils.hpp"
+#include "logging.h"
+
+namespace du = data_utils;
+
+
+// Largest absolute values of a 2D frame, kept per tile and combined up a pyramid so the
+// frame's maximum, where it is, and its sum of squares can be read from the top node.
+// When only part of the frame changes, only the tiles it overlaps are re-scanned and
+// only their ancestors are recombined, so keeping the maximum up to date costs in
+// proportion to the tiles touched rather than the frame size.
+// Searching down the pyramid also finds the tiles that hold values above a threshold
+// without visiting the rest.
+// 'T' is the precision of the data, sums of squares are always accumulated in double.
+template<class T=double>
+class TileMaxPyramid{
+	public:
+	static constexpr size_t default_tile_size = 32;
+
+	struct Node{
+		T value; // largest absolute value (keeping its sign, as 'du::absmax()')
+		size_t tile; // tile 'value' is in, see 'argmax()'
+		double sum_of_squares;
+	};
+
+	// All shapes are {x,y}, x is the fastest varying axis
+	std::vector<size_t> data_shape;
+	std::vector<size_t> tile_shape;
+	// 'levels[0]' has one node per tile, each node of a level above combines a 2x2 block of
+	// the level below, and the last level has one node.
+	std::vector<std::vector<size_t>> level_shapes;
+	std::vector<std::vector<Node>> levels;
+	// Tiles re-scanned since the last 'update_levels()', and whether each node needs recombining
+	std::vector<size_t> dirty_tiles;
+	std::vector<std::vector<bool>> is_dirty;
+
+	TileMaxPyramid();
+
+	void set_shape(const std::vector<size_t>& _data_shape, const size_t tile_size = default_tile_size);
+
+	// Scans all of 'data', which has 'data_shape'
+	void refresh(std::span<const T> data);
+	// Re-scans tile 'k' of 'data', 'update_levels()' must be called before the next query
+	void refresh_tile(size_t k, std::span<const T> data);
+	// As 'refresh_tile()', for callers that found the tile's extremes and sum of squares
+	// in a pass of their own
+	void set_tile(size_t k, T max_value, T min_value, double sum_of_squares);
+	// Recombines the ancestors of tiles refreshed since the last call
+	void update_levels();
+
+	// Tiles overlapping the rectangle of 'shape' starting at 'offset', which wraps around
+	// the edges of the frame
+	std::vector<size_t> tiles_overlapping(const std::vector<size_t>& offset, const std::vector<size_t>& shape) const;
+	// Tiles holding a value whose absolute value is above 'threshold'
+	std::vector<size_t> tiles_above(T threshold) const;
+	// First pixel of tile 'k', and its shape, tiles at the far edges can be smaller than 'tile_shape'
+	std::array<size_t,2> tile_offset(size_t k) const;
+	std::array<size_t,2> tile_extent(size_t k) const;
+
+	T absmax() const;
+	// Index of 'absmax()' in 'data', found by searching the one tile it is in. Only
+	// tile maxima are kept so refreshing a tile does not need a second pass.
+	size_t argmax(std::span<const T> data) const;
+	double sum_of_squares() const;
+};
+
+#endif //__TILE_MAX_PYRAMID_INCLUDED__
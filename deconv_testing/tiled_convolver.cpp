@@ -0,0 +1,131 @@
+#include "tiled_convolver.hpp"
+
+
+template<class T>
+TiledConvolver<T>::TiledConvolver()
+	: data_shape()
+	, kernel_shape()
+	, kernel_offset()
+	, tile_shape()
+	, block_shape()
+	, n_tiles_transformed(0)
+	, fft()
+	, ifft()
+	, kernel_fft()
+	, tile()
+	, tile_fft()
+{}
+
+template<class T>
+void TiledConvolver<T>::set_kernel(
+		const std::vector<size_t>& _data_shape,
+		const std::vector<T>& kernel,
+		const std::vector<size_t>& _kernel_shape,
+		const std::vector<size_t>& _kernel_offset,
+		const size_t tile_size,
+		const PlanRigor plan_rigor,
+		const size_t n_threads
+	){
+	GET_LOGGER;
+	assert(_data_shape.size() == 2);
+	assert(kernel.size() == du::product(_kernel_shape));
+
+	data_shape = _data_shape;
+	kernel_shape = _kernel_shape;
+	kernel_offset = _kernel_offset;
+
+	tile_shape.resize(data_shape.size());
+	block_shape.resize(data_shape.size());
+	for(size_t i=0; i<data_shape.size(); ++i){
+		// A tile must hold one block plus the kernel support (less one pixel) so the
+		// circular convolution of the tile does not wrap onto itself.
+		const size_t overlap = kernel_shape[i] - 1;
+		tile_shape[i] = std::min(
+			next_fast_fft_size(std::max(tile_size, 2*overlap + 1)),
+			next_fast_fft_size(data_shape[i] + overlap)
+		);
+		block_shape[i] = tile_shape[i] - overlap;
+	}
+	LOGV_DEBUG(data_shape, kernel_shape, tile_shape, block_shape);
+
+	fft.set_attrs(tile_shape, false, plan_rigor, true, n_threads);
+	ifft.set_attrs(tile_shape, true, plan_rigor, true, n_threads);
+
+	tile.resize(fft.size);
+	tile_fft.resize(fft.spectrum_size);
+	kernel_fft.resize(fft.spectrum_size);
+
+	// Put the kernel's origin on pixel 0 of the tile, wrapping the rest around
+	du::set_to(tile, T(0));
+	for(size_t j=0; j<kernel_shape[1]; ++j){
+		const size_t v = (j + tile_shape[1] - kernel_offset[1]) % tile_shape[1];
+		for(size_t i=0; i<kernel_shape[0]; ++i){
+			const size_t u = (i + tile_shape[0] - kernel_offset[0]) % tile_shape[0];
+			tile[u + v*tile_shape[0]] = kernel[i + j*kernel_shape[0]];
+		}
+	}
+	fft.execute(tile, kernel_fft);
+	ifft.normalise_spectrum(kernel_fft);
+}
+
+template<class T>
+void TiledConvolver<T>::convolve(std::span<const T> input, std::span<T> output){
+	assert((input.size() == du::product(data_shape)) && (output.size() == input.size()));
+	const size_t nx = data_shape[0], ny = data_shape[1];
+	const size_t tx = tile_shape[0], ty = tile_shape[1];
+
+	std::fill(output.begin(), output.end(), T(0));
+	n_tiles_transformed = 0;
+
+	for(size_t by=0; by<ny; by+=block_shape[1]){
+		const size_t bh = std::min(block_shape[1], ny-by);
+		for(size_t bx=0; bx<nx; bx+=block_shape[0]){
+			const size_t bw = std::min(block_shape[0], nx-bx);
+
+			// Copy block into the tile, noting if there is anything to convolve
+			du::set_to(tile, T(0));
+			bool is_empty = true;
+			for(size_t j=0; j<bh; ++j){
+				const T* in_row = input.data() + (by+j)*nx + bx;
+				T* tile_row = tile.data() + j*tx;
+				for(size_t i=0; i<bw; ++i){
+					tile_row[i] = in_row[i];
+					is_empty &= (in_row[i] == 0);
+				}
+			}
+			if (is_empty){
+				continue;
+			}
+			++n_tiles_transformed;
+
+			fft.execute(tile, tile_fft);
+			ifft.convolve(tile_fft, kernel_fft, tile);
+
+			// Only (block + kernel support - 1) pixels of the tile are non-zero, they
+			// start 'kernel_offset' pixels before the block. Add them back into the
+			// frame, wrapping around its edges.
+			const size_t out_w = bw + kernel_shape[0] - 1;
+			const size_t out_h = bh + kernel_shape[1] - 1;
+			const size_t x_start = (bx + nx - kernel_offset[0]) % nx;
+			const size_t u_start = (tx - kernel_offset[0]) % tx;
+			size_t y = (by + ny - kernel_offset[1]) % ny;
+			size_t v = (ty - kernel_offset[1]) % ty;
+			for(size_t j=0; j<out_h; ++j){
+				T* out_row = output.data() + y*nx;
+				const T* tile_row = tile.data() + v*tx;
+				size_t x = x_start;
+				size_t u = u_start;
+				for(size_t i=0; i<out_w; ++i){
+					out_row[x] += tile_row[u];
+					x = (x+1 == nx) ? 0 : x+1;
+					u = (u+1 == tx) ? 0 : u+1;
+				}
+				y = (y+1 == ny) ? 0 : y+1;
+				v = (v+1 == ty) ? 0 : v+1;
+			}
+		}
+	}
+}
+
+template class TiledConvolver<double>;
+template class TiledConvolver<float>;
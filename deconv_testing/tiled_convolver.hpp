@@ -0,0 +1,65 @@
+#ifndef __TILED_CONVOLVER_INCLUDED__
+#define __TILED_CONVOLVER_INCLUDED__
+
+#include <vector>
+#include <span>
+#include "data_utils.hpp"
+#include "fft.hpp"
+#include "logging.h"
+
+namespace du = data_utils;
+
+
+// Overlap-add convolution of a 2D frame with a small kernel. The frame is split into
+// blocks, each block is zero-padded by the kernel support into a tile of an FFT friendly
+// size, convolved, and added back into the output. Memory and FFT cost therefore depend
+// on the tile size and not on the frame size, and blocks that are all zero are skipped.
+//
+// The result is the same as the full-frame circular convolution of the input with the
+// kernel, i.e., contributions that fall off one edge of the frame wrap around to the other.
+// 'T' is the precision of the data and transforms.
+template<class T=double>
+class TiledConvolver{
+	public:
+	using complex=typename FourierTransformer<T>::complex;
+
+	static constexpr size_t default_tile_size = 128;
+
+	// All shapes are {x,y}, x is the fastest varying axis
+	std::vector<size_t> data_shape;
+	std::vector<size_t> kernel_shape;
+	// pixel of the kernel that is its origin, i.e., the kernel's value at zero shift
+	std::vector<size_t> kernel_offset;
+	// size of the FFTs, and number of input pixels each tile covers
+	std::vector<size_t> tile_shape;
+	std::vector<size_t> block_shape;
+	// how many tiles the last call to 'convolve()' transformed
+	size_t n_tiles_transformed;
+
+	FourierTransformer<T> fft;
+	FourierTransformer<T> ifft;
+	// Has the 1/tile_size normalisation of 'ifft' folded in
+	std::vector<complex> kernel_fft;
+	std::vector<T> tile;
+	std::vector<complex> tile_fft;
+
+	TiledConvolver();
+
+	// 'tile_size' is a target, tiles are always big enough to hold the kernel support
+	// twice over and are never much bigger than the frame.
+	void set_kernel(
+		const std::vector<size_t>& _data_shape,
+		const std::vector<T>& kernel,
+		const std::vector<size_t>& _kernel_shape,
+		const std::vector<size_t>& _kernel_offset,
+		const size_t tile_size = default_tile_size,
+		const PlanRigor plan_rigor = PlanRigor::ESTIMATE,
+		const size_t n_threads = 1
+	);
+
+	// Writes the convolution of 'input' with the kernel into 'output', both have
+	// 'data_shape' and must not overlap.
+	void convolve(std::span<const T> input, std::span<T> output);
+};
+
+#endif //__TILED_CONVOLVER_INCLUDED__